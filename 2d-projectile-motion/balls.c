@@ -20,10 +20,22 @@
 #include <stdint.h>
 #include <math.h>
 
+#include "trajectory.h"
+#include "projectiles.h"
+#include "solver.h"
+#include "telemetry.h"
+#include "pacer.h"
+
 #define SCREEN_WIDTH_PX 1600
 #define SCREEN_HEIGHT_PX 800
-#define ACC_GRAVITY_MPS 9.81f
 #define GROUND_HEIGHT_PX 750
+// quadratic air drag, toggled with the d key
+#define DRAG_COEFFICIENT 0.0005f
+// targets scattered with the t key, solved for every frame
+#define TARGET_COUNT 256
+#define MAX_LAUNCH_SPEED 2000.0f
+// projectiles fired at once with the b key, spread around the aim
+#define BURST_COUNT 20000
 
 typedef struct _Mouse {
     int x;
@@ -31,12 +43,14 @@ typedef struct _Mouse {
     uint32_t button;
 } Mouse;
 
+enum /* telemetry */ {TELEMETRY_CLEAR, TELEMETRY_PROJECTILES, TELEMETRY_SIZE};
+
 enum /* color */ {COLOR_RED, COLOR_GREEN, COLOR_BLUE, COLOR_ORANGE, COLOR_GREY,
                   COLOR_WHITE, COLOR_BLACK, COLOR_SIZE};
 
 void getMouse(Mouse *mouse);
-void update(SDL_Renderer *renderer, uint64_t frame, float seconds,
-            SDL_KeyCode key, Mouse *mouse);
+void update(SDL_Renderer *renderer, Telemetry *telemetry, uint64_t frame,
+            float seconds, SDL_KeyCode key, Mouse *mouse);
 void
 setColor(SDL_Renderer *renderer, uint8_t color);
 
@@ -67,12 +81,42 @@ drawBall(SDL_Renderer *renderer, int px, int py, uint8_t radius, uint8_t color)
     }
 }
 
+void
+formatClear(FILE *out, const Record *record)
+{
+    (void)record;
+    fprintf(out, "\033[2J"); // clear entire screen escape sequence
+}
+
+void
+formatProjectiles(FILE *out, const Record *record)
+{
+    fprintf(out, "\033[H"); // clear and set to home position escape sequence
+    fprintf(out, "seconds: %f\n", record->values[0]);
+    fprintf(out, "in flight: %-10d\n", (int)record->values[1]);
+    fprintf(out, "landed this frame: %-10d\n", (int)record->values[2]);
+}
+
 int main(void)
 {
     SDL_Window *window;
     SDL_Renderer *renderer;
+    Pacer pacer;
+    // big, keep it off the stack
+    static Telemetry telemetry;
+    static const Telemetry_formatter formatters[TELEMETRY_SIZE] = {
+        [TELEMETRY_CLEAR] = formatClear,
+        [TELEMETRY_PROJECTILES] = formatProjectiles,
+    };
 
-    printf("\033[2J"); // clear entire screen escape sequence
+    // set BALLS_TELEMETRY to a file name to log there instead of the terminal
+    if (!Telemetry_Start(&telemetry, getenv("BALLS_TELEMETRY"), formatters,
+                         TELEMETRY_SIZE)) {
+        fprintf(stderr, "could not start telemetry\n");
+        return 1;
+    }
+
+    Telemetry_Push(&telemetry, TELEMETRY_CLEAR, 0, NULL, 0);
 
     { // SDL Initialization
         if (SDL_Init(SDL_INIT_VIDEO) != 0)
@@ -84,62 +128,55 @@ int main(void)
                                              SCREEN_WIDTH_PX, SCREEN_HEIGHT_PX,
                                              SDL_WINDOW_SHOWN);
 
-        renderer = SDL_CreateRenderer(window, 0, SDL_RENDERER_SOFTWARE);
+        // set BALLS_VSYNC to let the display pace the frames
+        renderer = SDL_CreateRenderer(window, 0, SDL_RENDERER_SOFTWARE |
+                                      (getenv("BALLS_VSYNC") ?
+                                       SDL_RENDERER_PRESENTVSYNC : 0));
     } // SDL Initialization
 
 
     { // game loop
         bool quit = false;
         const uint16_t fps = 60;
-        const float mspd = (1.0f / (float)fps) * 1000.0f;
         uint64_t frame = 0;
         float seconds = 0;
 
-        while (!quit) {
-            uint32_t loop_start = SDL_GetTicks();
+        Pacer_Init(&pacer, fps, getenv("BALLS_VSYNC") != NULL);
 
+        while (!quit) {
             SDL_Event event;
             SDL_KeyCode key = 0;
             Mouse mouse;
-            bool keydown = false;
 
             getMouse(&mouse);
 
             while (SDL_PollEvent(&event)) {
                 switch (event.type) {
                 case SDL_KEYDOWN: {
-                    if (event.key.repeat == 0) {
-                        key = event.key.keysym.sym;
-                        keydown = true;
-                    }
+                    // held keys repeat, only the first press counts
+                    if (event.key.repeat == 0) key = event.key.keysym.sym;
                     break;
                 }
-                case SDL_KEYUP: keydown = false; break;
                 case SDL_QUIT: quit = true; break;
                 }
             }
 
             setColor(renderer, COLOR_BLACK);
             SDL_RenderClear(renderer);
-            update(renderer, frame, seconds, key, &mouse);
+            update(renderer, &telemetry, frame, seconds, key, &mouse);
             SDL_RenderPresent(renderer);
             frame++;
             seconds = ((float)frame / (float)fps);
 
-            uint32_t loop_end = SDL_GetTicks();
-            uint32_t elapsed_time = loop_end - loop_start;
-
-            uint32_t delay = ceilf(mspd - (float)elapsed_time);
-
-            if (delay > 0) {
-                SDL_Delay(delay);
-            }
+            Pacer_Wait(&pacer);
         }
 
     } // game loop
 
 
     { // quit
+        Telemetry_Stop(&telemetry);
+        Pacer_Print(&pacer, "projectile");
         SDL_DestroyRenderer(renderer);
         SDL_DestroyWindow(window);
         SDL_Quit();
@@ -152,77 +189,139 @@ void getMouse(Mouse * mouse)
     mouse->button = SDL_GetMouseState(&mouse->x, &mouse->y);
 }
 
-void drawPath(SDL_Renderer *renderer, SDL_Point *point, float velocity,
-              float angle, float seconds)
-    // velocity in meters per second
+void drawPath(SDL_Renderer *renderer, Telemetry *telemetry, uint64_t frame,
+              Projectiles *projectiles, float seconds)
 {
-    // REMEMBER! negative is upward and positive is downward. That is why
-    // the initial velocity for y (vi_y) is negative and acceleration due to
-    // gravity (ACC_GRAVITY_MPS) is positive
-    float vi_y = -velocity * sinf(angle);
-    float vi_x = velocity * cosf(angle);
-    float delta_x = (float)vi_x * (float)seconds;
-    float delta_y = (float)vi_y * (float)seconds + (0.5f * ACC_GRAVITY_MPS
-                        * (seconds * seconds));
-
-    // SDL_Rect rect = {
-    //     .x = point->x + delta_x,
-    //     .y = point->y + delta_y,
-    //     .w = 10,
-    //     .h = 10
-    // };
-    int tx = point->x + delta_x;
-    int ty = point->y + delta_y;
-
-    if (delta_y <= -1) {
-        printf("\033[H"); // clear and set to home position escape sequence
-        printf("seconds: %f\n", seconds);
-        printf("y displacement: %f\n", delta_y);
-        printf("x displacement: %f\n", delta_x);
-        printf("x: %d\n", tx);
-        printf("y: %d\n", ty);
-        // SDL_RenderFillRect(renderer, &rect);
-        drawBall(renderer, tx, ty, 20, COLOR_BLUE);
+    uint32_t landed = Projectiles_Update(projectiles, seconds);
+
+    // formatted and printed by the telemetry thread
+    if (projectiles->active_count > 0 || landed > 0) {
+        float values[] = {seconds, projectiles->active_count, landed};
+        Telemetry_Push(telemetry, TELEMETRY_PROJECTILES, frame, values, 3);
     }
 
+    // all of them in one call
+    setColor(renderer, COLOR_BLUE);
+    SDL_RenderFillRects(renderer, projectiles->rects,
+                        projectiles->active_count);
 }
 
-void update(SDL_Renderer *renderer, uint64_t frame, float seconds,
-            SDL_KeyCode key, Mouse *mouse)
+void update(SDL_Renderer *renderer, Telemetry *telemetry, uint64_t frame,
+            float seconds, SDL_KeyCode key, Mouse *mouse)
 {
-    static float launch_start = 0;
-    static float launch_angle = 0;
-    static float launch_initial = 0;
+    static Trajectory aim;
+    static Projectiles projectiles;
+    static int opposite = 0;
+    static int adjacent = 0;
+    static float drag = 0;
+    static Solver solver;
+    static SDL_Point targets[TARGET_COUNT];
+    static Shot shots[TARGET_COUNT];
+    static uint32_t target_count = 0;
 
     SDL_Point point = {
         .x = 10,
         .y = GROUND_HEIGHT_PX
     };
 
-    // 0 to 90 degrees (1/2 pi)
+    if (solver.max_speed == 0) Solver_Init(&solver, MAX_LAUNCH_SPEED);
+    if (projectiles.capacity == 0 &&
+        !Projectiles_Init(&projectiles, PROJECTILES_CAPACITY,
+                          GROUND_HEIGHT_PX)) {
+        fprintf(stderr, "could not allocate projectiles\n");
+        exit(1);
+    }
+
+    if (key == SDLK_d) drag = (drag > 0) ? 0 : DRAG_COEFFICIENT;
+
+    if (key == SDLK_t) {
+        target_count = TARGET_COUNT;
+        for (uint32_t i = 0; i < target_count; ++i) {
+            targets[i].x = rand() % SCREEN_WIDTH_PX;
+            targets[i].y = rand() % GROUND_HEIGHT_PX;
+        }
+    }
+
+    Solver_Solve(&solver, point, targets, shots, target_count);
+
+    for (uint32_t i = 0; i < target_count; ++i) {
+        SDL_Rect rect = {
+            .x = targets[i].x - 3,
+            .y = targets[i].y - 3,
+            .w = 6,
+            .h = 6
+        };
+        setColor(renderer, shots[i].hit ? COLOR_GREEN : COLOR_RED);
+        SDL_RenderFillRect(renderer, &rect);
+    }
+
+    // only redo the aim when the mouse moved or drag was toggled
+    if ((mouse->y - point.y) != opposite || (mouse->x - point.x) != adjacent ||
+        drag != aim.drag || aim.count == 0) {
+        opposite = (mouse->y - point.y);
+        adjacent = (mouse->x - point.x);
+
+        // 0 to 90 degrees (1/2 pi)
+        float angle = -atanf((float)opposite / (float)adjacent);
+        // hypotenuse is velocity
+        float velocity = sqrtf((opposite * opposite) + (adjacent * adjacent));
+
+        Trajectory_Build(&aim, point, velocity, angle, drag);
+    }
+
     setColor(renderer, COLOR_BLUE);
     SDL_RenderDrawLine(renderer, point.x, point.y, mouse->x, mouse->y);
 
-
-    int opposite = (mouse->y - point.y);
-    int adjacent = (mouse->x - point.x);
-    float angle = -atanf((float)opposite / (float)adjacent);
+    // preview of where the ball will go
+    setColor(renderer, COLOR_GREY);
+    SDL_RenderDrawLines(renderer, aim.points, aim.count);
 
     setColor(renderer, COLOR_RED);
     SDL_RenderDrawLine(renderer, 0, GROUND_HEIGHT_PX, SCREEN_WIDTH_PX,
                        GROUND_HEIGHT_PX);
 
-    if (mouse->button == 1) {
-        launch_start = seconds;
-        launch_angle = angle;
-        // hypotenuse is velocity
-        launch_initial = sqrtf((opposite * opposite) + (adjacent * adjacent));
+    // one every frame while the button is down, along the preview
+    if (mouse->button == 1)
+        Projectiles_Launch(&projectiles, seconds, point, aim.velocity,
+                           aim.angle, drag);
+
+    if (key == SDLK_b) {
+        for (uint32_t i = 0; i < BURST_COUNT; ++i) {
+            float spread = (rand() / (float)RAND_MAX) - 0.5f;
+            float speed = 1.0f + 0.2f * ((rand() / (float)RAND_MAX) - 0.5f);
+
+            if (!Projectiles_Launch(&projectiles, seconds, point,
+                                    aim.velocity * speed,
+                                    aim.angle + spread * 0.2f, drag))
+                break;
+        }
     }
 
-    if (launch_start > 0) {
-        drawPath(renderer, &point, launch_initial, launch_angle, seconds -
-                 launch_start);
+    // fire at the target closest to the mouse. The solver has no drag, so
+    // these always fly without it or they would fall short.
+    if (key == SDLK_f && target_count > 0) {
+        int closest = -1;
+        int closest_distance = 0;
+
+        for (uint32_t i = 0; i < target_count; ++i) {
+            int dx = targets[i].x - mouse->x;
+            int dy = targets[i].y - mouse->y;
+            int distance = dx * dx + dy * dy;
+
+            if (!shots[i].hit) continue;
+            if (closest < 0 || distance < closest_distance) {
+                closest = i;
+                closest_distance = distance;
+            }
+        }
+
+        if (closest >= 0)
+            Projectiles_Launch(&projectiles, seconds, point,
+                               shots[closest].velocity, shots[closest].angle,
+                               0);
     }
+
+    drawPath(renderer, telemetry, frame, &projectiles, seconds);
 }
 
 void
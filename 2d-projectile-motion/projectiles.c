@@ -0,0 +1,140 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "projectiles.h"
+#include "trajectory.h"
+
+bool
+Projectiles_Init(Projectiles *projectiles,
+                 uint32_t capacity,
+                 float ground)
+{
+    *projectiles = (Projectiles) {
+        .capacity = capacity,
+        .ground = ground,
+        .x0 = malloc(capacity * sizeof(float)),
+        .y0 = malloc(capacity * sizeof(float)),
+        .vx = malloc(capacity * sizeof(float)),
+        .vy = malloc(capacity * sizeof(float)),
+        .t0 = malloc(capacity * sizeof(float)),
+        .drag = malloc(capacity * sizeof(float)),
+        .steps = malloc(capacity * sizeof(uint32_t)),
+        .free = malloc(capacity * sizeof(uint32_t)),
+        .active = malloc(capacity * sizeof(uint32_t)),
+        .rects = malloc(capacity * sizeof(SDL_Rect)),
+    };
+
+    if (!projectiles->x0 || !projectiles->y0 || !projectiles->vx ||
+        !projectiles->vy || !projectiles->t0 || !projectiles->drag ||
+        !projectiles->steps || !projectiles->free ||
+        !projectiles->active || !projectiles->rects) {
+        Projectiles_Free(projectiles);
+        return false;
+    }
+
+    // hand out the low slots first
+    for (uint32_t i = 0; i < capacity; ++i)
+        projectiles->free[i] = capacity - 1 - i;
+    projectiles->free_count = capacity;
+
+    return true;
+}
+
+void
+Projectiles_Free(Projectiles *projectiles)
+{
+    free(projectiles->x0);
+    free(projectiles->y0);
+    free(projectiles->vx);
+    free(projectiles->vy);
+    free(projectiles->t0);
+    free(projectiles->drag);
+    free(projectiles->steps);
+    free(projectiles->free);
+    free(projectiles->active);
+    free(projectiles->rects);
+    *projectiles = (Projectiles) {0};
+}
+
+bool
+Projectiles_Launch(Projectiles *projectiles,
+                   float seconds,
+                   SDL_Point origin,
+                   float velocity,
+                   float angle,
+                   float drag)
+// Returns false if the pool is full.
+{
+    if (projectiles->free_count == 0) return false;
+
+    uint32_t slot = projectiles->free[--projectiles->free_count];
+
+    projectiles->x0[slot] = origin.x;
+    projectiles->y0[slot] = origin.y;
+    // REMEMBER! negative is upward and positive is downward
+    projectiles->vx[slot] = velocity * cosf(angle);
+    projectiles->vy[slot] = -velocity * sinf(angle);
+    projectiles->t0[slot] = seconds;
+    projectiles->drag[slot] = drag;
+    projectiles->steps[slot] = 0;
+    projectiles->active[projectiles->active_count++] = slot;
+    projectiles->launched++;
+    return true;
+}
+
+uint32_t
+Projectiles_Update(Projectiles *projectiles,
+                   float seconds)
+// Works out where every projectile is, retires the ones that reached the
+// ground and fills rects with the rest. Returns how many were retired.
+{
+    const float g = 0.5f * ACC_GRAVITY_MPS;
+    const float half = PROJECTILES_SIZE / 2;
+    uint32_t kept = 0;
+    uint32_t retired = 0;
+
+    for (uint32_t i = 0; i < projectiles->active_count; ++i) {
+        uint32_t slot = projectiles->active[i];
+        float t = seconds - projectiles->t0[slot];
+        float x, y;
+
+        if (projectiles->drag[slot] > 0) {
+            uint32_t *steps = &projectiles->steps[slot];
+
+            while ((*steps + 1) * TRAJECTORY_STEP <= t) {
+                Trajectory_Step(&projectiles->x0[slot], &projectiles->y0[slot],
+                                &projectiles->vx[slot], &projectiles->vy[slot],
+                                projectiles->drag[slot]);
+                (*steps)++;
+            }
+
+            float since = t - *steps * TRAJECTORY_STEP;
+            x = projectiles->x0[slot] + projectiles->vx[slot] * since;
+            y = projectiles->y0[slot] + projectiles->vy[slot] * since;
+        } else {
+            x = projectiles->x0[slot] + projectiles->vx[slot] * t;
+            y = projectiles->y0[slot] + projectiles->vy[slot] * t + g * t * t;
+        }
+
+        // launched from the ground, so skip the first instant
+        if (y >= projectiles->ground && t > 0) {
+            projectiles->free[projectiles->free_count++] = slot;
+            retired++;
+            continue;
+        }
+
+        // compacts the active list as it goes, launch order is kept
+        projectiles->active[kept] = slot;
+        projectiles->rects[kept] = (SDL_Rect) {
+            .x = x - half,
+            .y = y - half,
+            .w = PROJECTILES_SIZE,
+            .h = PROJECTILES_SIZE
+        };
+        kept++;
+    }
+
+    projectiles->active_count = kept;
+    projectiles->retired += retired;
+    return retired;
+}
@@ -0,0 +1,54 @@
+#ifndef PROJECTILES_H
+#define PROJECTILES_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Every projectile in flight, kept as separate arrays per field (structure of
+// arrays) in a pool allocated once. A launch takes a slot off the free list
+// and landing puts it back, so nothing is allocated while the game runs.
+// Positions are not stored, they come from the closed form motion and the
+// launch state every frame:
+//
+//   x = x0 + vx t
+//   y = y0 + vy t + g t^2 / 2
+//
+// Drag has no closed form. A projectile launched with drag is stepped with RK4
+// like the aim preview instead, its x0, y0, vx and vy are the state after the
+// steps taken so far and it moves on in a straight line between steps.
+
+#define PROJECTILES_CAPACITY (1 << 18)
+// how big a projectile is drawn, in pixels
+#define PROJECTILES_SIZE 3
+
+typedef struct _Projectiles {
+    uint32_t capacity;
+    float ground; // projectiles at or below this height are retired
+
+    // launch state, indexed by slot
+    float *x0, *y0;
+    float *vx, *vy;
+    float *t0; // seconds at launch
+    float *drag; // 0 for the closed form
+    uint32_t *steps; // RK4 steps taken, with drag only
+
+    uint32_t *free; // slots not in use
+    uint32_t free_count;
+    uint32_t *active; // slots in flight, in launch order
+    uint32_t active_count;
+
+    SDL_Rect *rects; // where the active ones are this frame, for drawing
+    uint64_t launched;
+    uint64_t retired;
+} Projectiles;
+
+bool Projectiles_Init(Projectiles *projectiles, uint32_t capacity,
+                      float ground);
+void Projectiles_Free(Projectiles *projectiles);
+bool Projectiles_Launch(Projectiles *projectiles, float seconds,
+                        SDL_Point origin, float velocity, float angle,
+                        float drag);
+uint32_t Projectiles_Update(Projectiles *projectiles, float seconds);
+
+#endif
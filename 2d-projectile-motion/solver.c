@@ -0,0 +1,103 @@
+#include <math.h>
+
+#include "solver.h"
+#include "trajectory.h"
+
+void
+Solver_Init(Solver *solver,
+            float max_speed)
+{
+    solver->max_speed = max_speed;
+
+    // open interval (0, pi/2), straight up is handled on its own
+    for (int i = 0; i < SOLVER_ANGLES; ++i) {
+        float angle = (i + 1) * (float)M_PI_2 / (SOLVER_ANGLES + 1);
+        float c = cosf(angle);
+
+        solver->angle[i] = angle;
+        solver->tan_angle[i / SOLVER_LANES][i % SOLVER_LANES] = tanf(angle);
+        solver->sec2_angle[i / SOLVER_LANES][i % SOLVER_LANES] =
+            1.0f / (c * c);
+    }
+}
+
+static void
+solveOne(const Solver *solver,
+         float dx,
+         float dy,
+         Shot *shot)
+// dx > 0, dy <= 0. Same equations as drawPath with t = dx / vi_x put in:
+//
+//   y = -dx tan(angle) + g dx^2 / (2 v^2 cos^2(angle))
+//
+// miss = y - dy = a + b / v^2 is zero at v^2 = b / -a, the speed that just
+// reaches the target. With a >= 0 the angle aims below it and no speed will do.
+{
+    const Lanes inf = (Lanes){0} + INFINITY;
+    Lanes lowest = inf; // v^2, the least so far in each lane
+    Mask chunk = (Mask){0}; // which vector of angles it came from
+
+    for (int j = 0; j < SOLVER_ANGLES / SOLVER_LANES; ++j) {
+        Lanes a = -dx * solver->tan_angle[j] - dy;
+        Lanes b = 0.5f * ACC_GRAVITY_MPS * dx * dx * solver->sec2_angle[j];
+        Mask below = a >= 0;
+        Lanes v2 = b / -a;
+
+        v2 = (Lanes)(((Mask)v2 & ~below) | ((Mask)inf & below));
+        Mask lower = v2 < lowest;
+        lowest = (Lanes)(((Mask)v2 & lower) | ((Mask)lowest & ~lower));
+        chunk = (chunk & ~lower) | (((Mask){0} + j) & lower);
+    }
+
+    float best = INFINITY;
+    int best_angle = -1;
+
+    for (int k = 0; k < SOLVER_LANES; ++k) {
+        int angle = chunk[k] * SOLVER_LANES + k;
+
+        if (lowest[k] < best) {
+            best = lowest[k];
+            best_angle = angle;
+        }
+    }
+
+    if (best_angle < 0) {
+        // every angle aims below the target, it is nearly straight up
+        shot->angle = solver->angle[SOLVER_ANGLES - 1];
+        shot->velocity = INFINITY;
+        shot->hit = false;
+        return;
+    }
+
+    shot->angle = solver->angle[best_angle];
+    shot->velocity = sqrtf(best);
+    shot->hit = shot->velocity <= solver->max_speed;
+}
+
+void
+Solver_Solve(const Solver *solver,
+             SDL_Point origin,
+             const SDL_Point *targets,
+             Shot *shots,
+             uint32_t count)
+// Finds the slowest shot from origin to each target. Targets below origin are
+// treated as being level with it.
+{
+    for (uint32_t i = 0; i < count; ++i) {
+        float dx = targets[i].x - origin.x;
+        float dy = fminf(targets[i].y - origin.y, 0);
+        Shot *shot = &shots[i];
+
+        if (dx == 0) {
+            // straight up, v^2 = 2gh
+            shot->angle = M_PI_2;
+            shot->velocity = sqrtf(2.0f * ACC_GRAVITY_MPS * -dy);
+            shot->hit = shot->velocity <= solver->max_speed;
+            continue;
+        }
+
+        // solve to the right and mirror the angle for targets on the left
+        solveOne(solver, fabsf(dx), dy, shot);
+        if (dx < 0) shot->angle = (float)M_PI - shot->angle;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// The other way around from drawPath: given a target, find the launch angle and
+// speed that hit it. For every target the exact speed that reaches it is worked
+// out for a fan of launch angles, a vector of angles at a time, and the angle
+// that needs the least speed wins.
+
+// eight floats with AVX, four with plain SSE
+#ifdef __AVX__
+#define SOLVER_LANES 8
+#else
+#define SOLVER_LANES 4
+#endif
+#define SOLVER_ANGLES 64 // multiple of SOLVER_LANES
+
+// gcc vector extension, becomes SSE or AVX depending on -march
+typedef float Lanes __attribute__((vector_size(SOLVER_LANES * sizeof(float))));
+typedef int32_t Mask __attribute__((vector_size(SOLVER_LANES * sizeof(float))));
+
+typedef struct _Shot {
+    float angle;
+    float velocity;
+    bool hit; // false when every angle needs more than max_speed
+} Shot;
+
+typedef struct _Solver {
+    float max_speed;
+    // everything that does not depend on the target is worked out once
+    float angle[SOLVER_ANGLES];
+    Lanes tan_angle[SOLVER_ANGLES / SOLVER_LANES];
+    Lanes sec2_angle[SOLVER_ANGLES / SOLVER_LANES]; // 1 / cos^2
+} Solver;
+
+void Solver_Init(Solver *solver, float max_speed);
+void Solver_Solve(const Solver *solver, SDL_Point origin,
+                  const SDL_Point *targets, Shot *shots, uint32_t count);
+
+#endif
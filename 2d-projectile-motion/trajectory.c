@@ -0,0 +1,119 @@
+#include <math.h>
+
+#include "trajectory.h"
+
+typedef struct _State {
+    float x, y, vx, vy;
+} State;
+
+static State
+derive(State s,
+       float drag)
+// Quadratic air drag, a = g - k|v|v. Positive y is downward.
+{
+    float speed = sqrtf(s.vx * s.vx + s.vy * s.vy);
+
+    return (State) {
+        .x = s.vx,
+        .y = s.vy,
+        .vx = -drag * speed * s.vx,
+        .vy = ACC_GRAVITY_MPS - drag * speed * s.vy,
+    };
+}
+
+static State
+advance(State s,
+        State d,
+        float h)
+{
+    return (State) {
+        .x = s.x + d.x * h,
+        .y = s.y + d.y * h,
+        .vx = s.vx + d.vx * h,
+        .vy = s.vy + d.vy * h,
+    };
+}
+
+static State
+rk4(State s,
+    float drag,
+    float h)
+{
+    State k1 = derive(s, drag);
+    State k2 = derive(advance(s, k1, h * 0.5f), drag);
+    State k3 = derive(advance(s, k2, h * 0.5f), drag);
+    State k4 = derive(advance(s, k3, h), drag);
+
+    return (State) {
+        .x = s.x + h / 6.0f * (k1.x + 2.0f * k2.x + 2.0f * k3.x + k4.x),
+        .y = s.y + h / 6.0f * (k1.y + 2.0f * k2.y + 2.0f * k3.y + k4.y),
+        .vx = s.vx + h / 6.0f * (k1.vx + 2.0f * k2.vx + 2.0f * k3.vx + k4.vx),
+        .vy = s.vy + h / 6.0f * (k1.vy + 2.0f * k2.vy + 2.0f * k3.vy + k4.vy),
+    };
+}
+
+bool
+Trajectory_Build(Trajectory *trajectory,
+                 SDL_Point origin,
+                 float velocity,
+                 float angle,
+                 float drag)
+// Samples the path every TRAJECTORY_STEP seconds until it comes back down to
+// the height it was launched from. Returns false and leaves the samples alone
+// when they were already built for the same launch.
+{
+    if (trajectory->count > 0 &&
+        trajectory->origin.x == origin.x && trajectory->origin.y == origin.y &&
+        trajectory->velocity == velocity && trajectory->angle == angle &&
+        trajectory->drag == drag)
+        return false;
+
+    trajectory->origin = origin;
+    trajectory->velocity = velocity;
+    trajectory->angle = angle;
+    trajectory->drag = drag;
+
+    // REMEMBER! negative is upward and positive is downward
+    float vi_y = -velocity * sinf(angle);
+    float vi_x = velocity * cosf(angle);
+    State s = {.x = 0, .y = 0, .vx = vi_x, .vy = vi_y};
+    uint32_t i = 0;
+
+    for (; i < TRAJECTORY_MAX_POINTS; ++i) {
+        if (drag > 0) {
+            if (i > 0) s = rk4(s, drag, TRAJECTORY_STEP);
+        } else {
+            // no drag has an exact answer, no need to integrate
+            float t = i * TRAJECTORY_STEP;
+            s.x = vi_x * t;
+            s.y = vi_y * t + (0.5f * ACC_GRAVITY_MPS * (t * t));
+        }
+
+        trajectory->points[i].x = origin.x + s.x;
+        trajectory->points[i].y = origin.y + s.y;
+
+        if (i > 0 && s.y > 0) {
+            i++;
+            break;
+        }
+    }
+
+    trajectory->count = i;
+    return true;
+}
+
+void
+Trajectory_Step(float *x,
+                float *y,
+                float *vx,
+                float *vy,
+                float drag)
+// One RK4 step of TRAJECTORY_STEP seconds.
+{
+    State s = rk4((State) {*x, *y, *vx, *vy}, drag, TRAJECTORY_STEP);
+
+    *x = s.x;
+    *y = s.y;
+    *vx = s.vx;
+    *vy = s.vy;
+}
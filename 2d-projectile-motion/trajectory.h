@@ -0,0 +1,34 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// The aiming preview is sampled once per aim and kept, so it is not worked out
+// again every frame while the aim does not change. Projectiles launched with
+// drag are stepped with Trajectory_Step, the same steps the preview is sampled
+// with, so they fly along it.
+
+#define ACC_GRAVITY_MPS 9.81f
+
+// seconds between samples, also the RK4 step when drag is on
+#define TRAJECTORY_STEP (1.0f / 30.0f)
+#define TRAJECTORY_MAX_POINTS 16384
+
+typedef struct _Trajectory {
+    // what the samples were built from, used to tell if they are still good
+    SDL_Point origin;
+    float velocity;
+    float angle;
+    float drag;
+
+    uint32_t count;
+    SDL_Point points[TRAJECTORY_MAX_POINTS]; // for SDL_RenderDrawLines
+} Trajectory;
+
+bool Trajectory_Build(Trajectory *trajectory, SDL_Point origin, float velocity,
+                      float angle, float drag);
+void Trajectory_Step(float *x, float *y, float *vx, float *vy, float drag);
+
+#endif
@@ -6,6 +6,13 @@
 #include <stdint.h>
 #include <math.h>
 #include <SDL2/SDL_rect.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "events.h"
+#include "pacer.h"
+#include "trace.h"
+#include "hud.h"
 
 // NOTE:
 // This is a less accurate depiction of gravity. I am using a different number
@@ -15,6 +22,7 @@
 // be THAT accurate.
 #define METER_AS_PIXELS 3779U
 // #define GRAVITY 0.5f
+#define BALL_COUNT 64
 
 #define END(check, str1, str2) \
     if (check) { \
@@ -34,19 +42,14 @@ typedef struct _Game {
     float gravity;
     float terminal_velocity;
     SDL_Rect screen_rect;
+    Bounce bounce;
+    Pacer pacer;
+    Trace trace;
+    Hud hud;
+    uint64_t advance_ticks; // how long the last Bounce_Advance took
+    uint64_t events; // impacts handled up to last frame
 } Game;
 
-typedef struct _Ball {
-    SDL_Point center; 
-    SDL_Point velocities;
-    uint16_t radius;
-    bool down; // check if the ball is 
-    // these two varaibles reset with each fall
-    float time_falling; // time it takes to fall from peak
-    float height_falling; // max height for each fall
-    float e; // restition value
-} Ball;
-
 typedef uint8_t (*Update_callback) (Game *game, 
                                     float seconds, 
                                     uint64_t frame,
@@ -130,26 +133,28 @@ updateNothing(Game *game,
     return UPDATE_NOTHING;
 }
 
-void
-worldBoundry(Game *game, Ball *ball)
+static void
+drawHud(Game *game)
 {
-    int padding = 1;
-
-    if (ball->center.x - ball->radius <= 0) {
-        ball->center.x = ball->radius + padding;
-    }
-
-    if (ball->center.y - ball->radius <= 0) {
-        ball->center.y = ball->radius + padding;
-    }
-
-    if (ball->center.x + ball->radius >= game->screen_rect.w) {
-        ball->center.x = game->screen_rect.w - ball->radius - padding;
-    }
-
-    if (ball->center.y + ball->radius >= game->screen_rect.h) {
-        ball->center.y = game->screen_rect.h - ball->radius - padding;
-    }
+    Bounce *bounce = &game->bounce;
+    Hud *hud = &game->hud;
+    uint32_t resting = 0;
+    int y = 4;
+
+    for (uint32_t i = 0; i < bounce->ball_count; ++i)
+        resting += bounce->balls[i].resting;
+
+    Hud_Begin(hud);
+    y = Hud_Print(hud, 4, y, "%.0f fps", hud->fps);
+    y = Hud_Print(hud, 4, y, "advance %.3f ms",
+                  game->advance_ticks * 1000.0 / hud->frequency);
+    y = Hud_Print(hud, 4, y, "balls %u", bounce->ball_count);
+    y = Hud_Print(hud, 4, y, "impacts %lu",
+                  (unsigned long)(bounce->event_count - game->events));
+    y = Hud_Print(hud, 4, y, "resting %u", resting);
+    Hud_Draw(hud, game->renderer);
+
+    game->events = bounce->event_count;
 }
 
 static uint8_t
@@ -159,54 +164,33 @@ updateMain(Game *game,
            SDL_KeyCode key,
            bool keydown)
 {
-    // as long as gravity and time are using the same units the fomrulas will
-    // work. in this case we will do frames as out unit
-    // * Rubber ball: (e \approx 0.8 - 0.9)
-    // * Basketball: (e \approx 0.75)
-    // * Tennis ball: (e \approx 0.6)
-    static Ball ball = {
-        .center = {.x = 400, .y = 400},
-        .radius = 30,
-        .down = true,
-        .e = 0.9f
-    };
-
-    static float initial_y = 400;
-    static float y = 400;
-    static float restitution = 1;
-    static float f = 0;
-    static float acceleration = 0;
+    Bounce *bounce = &game->bounce;
 
+    // only the balls that hit something are touched here
+    Trace_Begin(&game->trace, "advance");
+    uint64_t start = SDL_GetPerformanceCounter();
+    Bounce_Advance(bounce, seconds);
+    game->advance_ticks = SDL_GetPerformanceCounter() - start;
+    Trace_End(&game->trace, "advance");
 
-    if (ball.down)  // falling downward
-        acceleration += (game->gravity * f);
-     else 
-        acceleration -= restitution - (game->gravity * f);
+    game->out_of_bounds = false;
 
-    // clip this to world border
-    ball.center.y = y + acceleration;
+    Trace_Begin(&game->trace, "draw");
+    for (uint32_t i = 0; i < bounce->ball_count; ++i) {
+        Ball *ball = &bounce->balls[i];
+        float x, y;
 
-    // ball.height_falling = initial_y + (0.5f * game->gravity) * (f * f);
+        Bounce_Position(bounce, i, seconds, &x, &y);
+        SDL_Point center = {.x = x, .y = y};
 
-    // ball.time_falling = sqrt(2 * (initial_y - ball.radius) / game->gravity);
-    //
-    // This if statement cannot be used because
-     // if (f > time && ball.down) {
-     if ((ball.center.y + ball.radius >= game->screen_rect.h) &&
-         restitution >= 0) {
-         f = 0;
-         ball.down = false;
-         restitution *= ball.e;
-     }
+        // Should not go out of bounds. but check if it does
+        if (!circleRectCollide(center, ball->radius, game->screen_rect))
+            game->out_of_bounds = true;
 
-    worldBoundry(game, &ball);
-
-    // Should not go out of bounds. but check if it does
-     game->out_of_bounds =
-        !circleRectCollide(ball.center, ball.radius, game->screen_rect);
-
-    drawCircle(game->renderer, ball.radius, ball.center, COLOR_RED);
-    f++;
+        drawCircle(game->renderer, ball->radius, center, ball->color);
+    }
+    drawHud(game);
+    Trace_End(&game->trace, "draw");
 
     return UPDATE_MAIN;
 }
@@ -222,16 +206,16 @@ Game_Update(Game *game)
     bool keydown = false;
     uint8_t update_id = 0;
     Update_callback update;
-    float mspd = (1.0f / (float)game->fps) * 1000.0f;
     float seconds = 0;
     SDL_Event event;
     SDL_KeyCode key = 0;
-    uint32_t end = 0;
-    uint32_t elapsed_time = 0;
     uint8_t color = COLOR_BLACK;
 
+    // set BALLS_VSYNC to let the display pace the frames
+    Pacer_Init(&game->pacer, game->fps, getenv("BALLS_VSYNC") != NULL);
+
     while (!quit) {
-        uint32_t start = SDL_GetTicks();
+        Trace_Begin(&game->trace, "frame");
         // clear screen
         if (game->out_of_bounds) color = COLOR_GREEN;
         setColor(game->renderer, color);
@@ -252,6 +236,7 @@ Game_Update(Game *game)
 
 
 
+        Trace_Begin(&game->trace, "events");
         while (SDL_PollEvent(&event)) {
             switch (event.type) {
                 case SDL_KEYDOWN: {
@@ -267,22 +252,44 @@ Game_Update(Game *game)
                 case SDL_QUIT: quit = true; break;
             }
         }
+        Trace_End(&game->trace, "events");
 
+        Trace_Begin(&game->trace, "update");
         update_id = update(game, seconds, frame, key, keydown);
+        Trace_End(&game->trace, "update");
 
-        end = SDL_GetTicks();
-        elapsed_time = end - start;
-
-        if (elapsed_time < mspd) {
-            elapsed_time = mspd - elapsed_time;
-            SDL_Delay(elapsed_time);
-        } 
-
+        Trace_Begin(&game->trace, "present");
         SDL_RenderPresent(game->renderer);
+        Trace_End(&game->trace, "present");
+
+        Trace_Begin(&game->trace, "wait");
+        Pacer_Wait(&game->pacer);
+        Trace_End(&game->trace, "wait");
+        Trace_End(&game->trace, "frame");
         frame++;
     }
 }
 
+void
+createBalls(Game *game)
+{
+    // * Rubber ball: (e \approx 0.8 - 0.9)
+    // * Basketball: (e \approx 0.75)
+    // * Tennis ball: (e \approx 0.6)
+    for (int i = 0; i < BALL_COUNT; ++i) {
+        float radius = 10 + (rand() / (float)RAND_MAX) * 20;
+        float x = radius + (rand() / (float)RAND_MAX) *
+                  (game->screen_rect.w - radius * 2);
+        float y = radius + (rand() / (float)RAND_MAX) *
+                  (game->screen_rect.h / 2.0f);
+        float vx = ((rand() / (float)RAND_MAX) - 0.5f) * 200.0f;
+        float e = 0.6f + (rand() / (float)RAND_MAX) * 0.3f;
+        uint8_t color = i % COLOR_GREY;
+
+        Bounce_Add(&game->bounce, 0, x, y, vx, 0, radius, e, color);
+    }
+}
+
 void
 Game_Init(Game *game)
 // All the variable and data initialization needed for SDL and perhaps game
@@ -308,17 +315,42 @@ Game_Init(Game *game)
     END(game->window == NULL, "Could not create window", SDL_GetError());
 
     game->renderer = SDL_CreateRenderer(game->window, 0,
-                                        SDL_RENDERER_SOFTWARE);
+                                        SDL_RENDERER_SOFTWARE |
+                                        (getenv("BALLS_VSYNC") ?
+                                         SDL_RENDERER_PRESENTVSYNC : 0));
 
     END(game->renderer == NULL, "Could not create renderer", SDL_GetError());
     game->fps = 400;
     // game->terminal_velocity = 
-    game->gravity  = 0.004f;
+    // pixels per second squared, the old 0.004 pixels per frame squared at
+    // 400 fps
+    game->gravity  = 640.0f;
+
+    END(!Bounce_Init(&game->bounce, BALL_COUNT, game->gravity,
+                     game->screen_rect.w, game->screen_rect.h),
+        "Bounce_Init()", "could not allocate balls");
+
+    // set BALLS_TRACE to a file name to record a timeline of every frame
+    END(!Trace_Start(&game->trace, getenv("BALLS_TRACE")), "Trace_Start()",
+        "could not allocate the trace buffer");
+
+    // set BALLS_FONT to draw the stats with another font, the HUD is left off
+    // if the font is not there
+    const char *font = getenv("BALLS_FONT");
+    Hud_Init(&game->hud, game->renderer, font ? font : HUD_FONT,
+             HUD_FONT_SIZE);
+
+    srand(time(NULL));
+    createBalls(game);
 }
 
 void
 Game_Quit(Game *game)
 {
+    Trace_Stop(&game->trace);
+    Pacer_Print(&game->pacer, "bounce");
+    Bounce_Free(&game->bounce);
+    Hud_Free(&game->hud);
     SDL_DestroyWindow(game->window);
     SDL_DestroyRenderer(game->renderer);
     TTF_Quit();
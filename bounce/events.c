@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "events.h"
+
+static void
+heapSwap(Event *queue, uint32_t a, uint32_t b)
+{
+    Event tmp = queue[a];
+    queue[a] = queue[b];
+    queue[b] = tmp;
+}
+
+static void
+heapUp(Event *queue, uint32_t i)
+{
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (queue[parent].t <= queue[i].t) break;
+        heapSwap(queue, parent, i);
+        i = parent;
+    }
+}
+
+static void
+heapDown(Event *queue, uint32_t size, uint32_t i)
+{
+    for (;;) {
+        uint32_t left = i * 2 + 1;
+        uint32_t right = left + 1;
+        uint32_t smallest = i;
+
+        if (left < size && queue[left].t < queue[smallest].t) smallest = left;
+        if (right < size && queue[right].t < queue[smallest].t) smallest = right;
+        if (smallest == i) break;
+        heapSwap(queue, smallest, i);
+        i = smallest;
+    }
+}
+
+static void
+nextEvent(const Bounce *bounce,
+          Ball *ball,
+          double *t)
+// Solves for the next impact of the ball from its state at t0. Sets ball->next
+// to EVENT_NONE when the ball will never hit anything again.
+{
+    float floor_y = bounce->height - ball->radius;
+    float tau_floor = INFINITY;
+    float tau_wall = INFINITY;
+
+    // y0 + vy * tau + g / 2 * tau^2 = floor_y, taking the positive root
+    if (!ball->resting) {
+        float d = fmaxf(floor_y - ball->y0, 0);
+        tau_floor = (-ball->vy + sqrtf(ball->vy * ball->vy +
+                     2.0f * bounce->gravity * d)) / bounce->gravity;
+    }
+
+    if (ball->vx > 0)
+        tau_wall = (bounce->width - ball->radius - ball->x0) / ball->vx;
+    else if (ball->vx < 0)
+        tau_wall = (ball->radius - ball->x0) / ball->vx;
+
+    tau_wall = fmaxf(tau_wall, 0);
+
+    if (tau_floor == INFINITY && tau_wall == INFINITY) {
+        ball->next = EVENT_NONE;
+        return;
+    }
+
+    if (tau_floor <= tau_wall) {
+        ball->next = EVENT_FLOOR;
+        *t = ball->t0 + tau_floor;
+    } else {
+        ball->next = EVENT_WALL;
+        *t = ball->t0 + tau_wall;
+    }
+}
+
+bool
+Bounce_Init(Bounce *bounce,
+            uint32_t capacity,
+            float gravity,
+            float width,
+            float height)
+{
+    memset(bounce, 0, sizeof(Bounce));
+    bounce->balls = calloc(capacity, sizeof(Ball));
+    bounce->queue = calloc(capacity, sizeof(Event));
+    if (!bounce->balls || !bounce->queue) {
+        Bounce_Free(bounce);
+        return false;
+    }
+    bounce->capacity = capacity;
+    bounce->gravity = gravity;
+    bounce->width = width;
+    bounce->height = height;
+    return true;
+}
+
+void
+Bounce_Free(Bounce *bounce)
+{
+    free(bounce->balls);
+    free(bounce->queue);
+    bounce->balls = NULL;
+    bounce->queue = NULL;
+    bounce->ball_count = 0;
+    bounce->queue_size = 0;
+    bounce->capacity = 0;
+}
+
+bool
+Bounce_Add(Bounce *bounce,
+           double t,
+           float x,
+           float y,
+           float vx,
+           float vy,
+           float radius,
+           float e,
+           uint8_t color)
+{
+    if (bounce->ball_count >= bounce->capacity) return false;
+
+    uint32_t i = bounce->ball_count++;
+    Ball *ball = &bounce->balls[i];
+    *ball = (Ball) {
+        .t0 = t,
+        .x0 = x,
+        .y0 = y,
+        .vx = vx,
+        .vy = vy,
+        .radius = radius,
+        .e = e,
+        .color = color,
+    };
+
+    double next;
+    nextEvent(bounce, ball, &next);
+    if (ball->next == EVENT_NONE) return true;
+
+    bounce->queue[bounce->queue_size] = (Event) {.t = next, .ball = i};
+    heapUp(bounce->queue, bounce->queue_size++);
+    return true;
+}
+
+void
+Bounce_Advance(Bounce *bounce,
+               double t)
+// Handles every impact up to time t in order. The cost is the number of
+// impacts, balls that are in the air are not touched.
+{
+    float g = bounce->gravity;
+
+    while (bounce->queue_size > 0 && bounce->queue[0].t <= t) {
+        Event *event = &bounce->queue[0];
+        Ball *ball = &bounce->balls[event->ball];
+        float tau = event->t - ball->t0;
+
+        float x = ball->x0 + ball->vx * tau;
+        float y = ball->y0;
+        float vy = 0;
+
+        if (!ball->resting) {
+            y += ball->vy * tau + 0.5f * g * tau * tau;
+            vy = ball->vy + g * tau;
+        }
+
+        if (ball->next == EVENT_FLOOR) {
+            y = bounce->height - ball->radius;
+            vy = -ball->e * vy;
+
+            // bounce height is v^2 / 2g
+            if ((vy * vy) / (2.0f * g) < BOUNCE_REST_HEIGHT) {
+                vy = 0;
+                ball->resting = true;
+            }
+        } else {
+            x = (ball->vx > 0) ? bounce->width - ball->radius : ball->radius;
+            ball->vx = -ball->e * ball->vx;
+        }
+
+        ball->t0 = event->t;
+        ball->x0 = x;
+        ball->y0 = y;
+        ball->vy = vy;
+        bounce->event_count++;
+
+        double next;
+        nextEvent(bounce, ball, &next);
+        if (ball->next == EVENT_NONE) {
+            bounce->queue[0] = bounce->queue[--bounce->queue_size];
+        } else {
+            event->t = next;
+        }
+        heapDown(bounce->queue, bounce->queue_size, 0);
+    }
+}
+
+void
+Bounce_Position(const Bounce *bounce,
+                uint32_t i,
+                double t,
+                float *x,
+                float *y)
+// Evaluates the parabola of a ball since its last impact. Only valid up to the
+// time of its next event, so call Bounce_Advance first.
+{
+    const Ball *ball = &bounce->balls[i];
+    float tau = t - ball->t0;
+
+    *x = ball->x0 + ball->vx * tau;
+    *y = ball->y0;
+    if (!ball->resting)
+        *y += ball->vy * tau + 0.5f * bounce->gravity * tau * tau;
+}
@@ -0,0 +1,57 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Event driven bouncing. Under constant gravity the path of a ball between two
+// impacts is a parabola, so the time of the next impact can be solved for
+// directly instead of stepping every frame and checking the floor afterwards.
+// Each ball keeps the state it had at its last impact and one pending event in
+// a min heap ordered by time. A ball is only touched when its own event comes
+// up; everything in between is evaluated from the parabola.
+
+// Once a bounce would rise less than this many pixels the ball stops bouncing
+// and rolls along the floor. Without it the impacts get closer and closer
+// together and the queue never empties (Zeno's ball).
+#define BOUNCE_REST_HEIGHT 0.5f
+
+enum {EVENT_NONE, EVENT_FLOOR, EVENT_WALL};
+
+typedef struct _Ball {
+    // state at time t0, the time of the last impact
+    double t0;
+    float x0, y0, vx, vy;
+    float radius;
+    float e; // restitution value
+    uint8_t color;
+    bool resting; // no longer bouncing, can still roll into walls
+    uint8_t next; // kind of the pending event
+} Ball;
+
+typedef struct _Event {
+    double t;
+    uint32_t ball;
+} Event;
+
+typedef struct _Bounce {
+    Ball *balls;
+    uint32_t ball_count;
+    uint32_t capacity;
+    Event *queue; // binary min heap on t
+    uint32_t queue_size;
+    float gravity; // pixels per second squared, positive is down
+    float width, height;
+    uint64_t event_count; // impacts handled since init
+} Bounce;
+
+bool Bounce_Init(Bounce *bounce, uint32_t capacity, float gravity, float width,
+                 float height);
+void Bounce_Free(Bounce *bounce);
+bool Bounce_Add(Bounce *bounce, double t, float x, float y, float vx, float vy,
+                float radius, float e, uint8_t color);
+void Bounce_Advance(Bounce *bounce, double t);
+void Bounce_Position(const Bounce *bounce, uint32_t i, double t, float *x,
+                     float *y);
+
+#endif
@@ -5,13 +5,36 @@
 #include <math.h>
 #include <stdlib.h>
 #include <time.h>
+#include <signal.h>
 
 #include <SDL2/SDL_rect.h>
 #include <SDL2/SDL_ttf.h>
 #include <SDL2/SDL.h>
 
+#include "telemetry.h"
+#include "pacer.h"
+#include "export.h"
+#include "world.h"
+#include "arena.h"
+#include "batch.h"
+#include "dirty.h"
+#include "perf.h"
+#include "trace.h"
+#include "raster.h"
+#include "hud.h"
+#include "pool.h"
+#include "alloc.h"
+#include "publish.h"
+#include "slabs.h"
+
 #define METER_AS_PIXELS 3779U
 #define BALL_COUNT 30
+// balls start with this speed in a random direction when exporting, so there
+// is something to watch without a mouse
+#define EXPORT_BALL_SPEED 300.0f
+
+// the world's phases come first
+#define PERF_DRAW WORLD_PHASES
 
 // (BALL_COUNT * (BALL_COUNT - 1)) / 2
 // #define BALL_DISTINCT_UNORDERED_PAIRS 435
@@ -25,12 +48,10 @@
 
 #define SDL_main main
 
-typedef struct _Ball {
-    float px, py, vx, vy, ax, ay;
-    float radius;
-    uint8_t color;
-    float mass;
-} Ball;
+// Make sure last color is always black
+enum {COLOR_RED, COLOR_GREEN, COLOR_BLUE, COLOR_ORANGE, COLOR_GREY,
+      COLOR_PURPLE, COLOR_NEON_GREEN, COLOR_PINK, COLOR_YELLOW, COLOR_WHITE, 
+      COLOR_BLACK, COLOR_SIZE};
 
 typedef struct _Mouse {
     SDL_Point p;
@@ -43,13 +64,37 @@ typedef struct _Game {
     SDL_Surface *backbuffer;
     SDL_Window *window;
     const SDL_Rect screen_rect;
-    Ball balls[BALL_COUNT];
+    World world;
+    Arena arena; // everything the world needs
     uint32_t fps;
     float terminal_velocity;
     uint8_t ball_size_min;
     uint8_t ball_size_max;
-    Ball **balls_colliding;
-    uint8_t collision_count;
+    Telemetry telemetry;
+    Pacer pacer;
+    Perf perf;
+    Trace trace;
+    bool headless; // no window, frames are exported
+    float initial_speed;
+
+    // The window only redraws what changed. The raster draws into the
+    // backbuffer, which keeps last frame's picture, on all the pool's threads
+    // and only the dirty parts of it are uploaded to the screen texture.
+    Pool pool;
+    Raster raster;
+    SDL_Texture *screen;
+    Dirty dirty;
+    SDL_Rect *drawn; // where each ball was drawn last frame, by id
+    SDL_Rect drawn_cursor;
+    SDL_Rect drawn_line;
+    int drawn_selected;
+    bool redraw; // everything is dirty
+
+    Hud hud;
+    uint64_t step_ticks; // how long the last World_Step took
+
+    Publish publish; // every step, for other processes
+    uint32_t palette[COLOR_SIZE]; // colors as 0xRRGGBBAA
 } Game;
 
 
@@ -62,10 +107,10 @@ typedef uint8_t (*Update_callback) (Game *game,
 
 enum {UPDATE_MAIN, UPDATE_NOTHING};
 
-// Make sure last color is always black
-enum {COLOR_RED, COLOR_GREEN, COLOR_BLUE, COLOR_ORANGE, COLOR_GREY,
-      COLOR_PURPLE, COLOR_NEON_GREEN, COLOR_PINK, COLOR_YELLOW, COLOR_WHITE, 
-      COLOR_BLACK, COLOR_SIZE};
+enum {TELEMETRY_BYTE_ORDER, TELEMETRY_SIZE};
+
+// parts of a frame allocations are counted in, see alloc.h
+enum {FRAME_EVENTS, FRAME_STEP, FRAME_DRAW, FRAME_PRESENT, FRAME_PHASES};
 
 const SDL_Color colors[] = {
     [COLOR_RED] = {.r = 217, .g = 100, .b = 89, .a = 255},
@@ -99,14 +144,15 @@ bool ballCollide(Ball b1,
 {
     return fabs((b1.px - b2.px) * (b1.px - b2.px) +
            (b1.py - b2.py) * (b1.py - b2.py)) <=
-           (b1.radius + b2.radius) * (b1.radius + b2.radius);
+           (Ball_Radius(&b1) + Ball_Radius(&b2)) *
+           (Ball_Radius(&b1) + Ball_Radius(&b2));
 }
 
 bool pointInBall(Ball b,
                  SDL_Point p)
 {
     return fabs((b.px - p.x) * (b.px - p.x) + (b.py - p.y) * (b.py - p.y))
-           <= (b.radius * b.radius);
+           <= (Ball_Radius(&b) * Ball_Radius(&b));
 }
 
 void
@@ -129,15 +175,6 @@ drawCircle(SDL_Renderer *renderer,
         int ry = (y * radius);
         int tx = rx + px;
         int ty = ry + py;
-        // wraping
-        // This works except in case where a ball is in the corner. Than the
-        // ball will apear in all four courners
-        // SDL_Rect point = {
-        //     .x = (tx > border.w) ? tx -= border.w : (tx < 0) ? tx += border.w : tx, 
-        //     .y = (ty > border.h) ? ty -= border.h : (ty < 0) ? ty += border.h : ty, 
-        //     w, 
-        //     w
-        // };
         SDL_Rect point = {
             .x = tx, 
             .y = ty, 
@@ -156,16 +193,18 @@ drawBall(SDL_Renderer *renderer,
 // Drawing a circle with the standard circle formula.
 // There may be a more performant way to do this...
 {
-    setColor(renderer, ball.color);
+    setColor(renderer, Ball_Color(&ball));
+
+    float radius = Ball_Radius(&ball);
 
     // diameter is radius * 2
-    for (int x = 0; x < ball.radius * 2; x++) {
-        for (int y = 0; y < ball.radius * 2; y++) {
-          if ( ((x - ball.radius) * (x - ball.radius)) +
-               ((y - ball.radius) * (y - ball.radius)) <=
-               ball.radius * ball.radius) {
-            int px = ball.px - ball.radius + x;
-            int py = ball.py - ball.radius + y;
+    for (int x = 0; x < radius * 2; x++) {
+        for (int y = 0; y < radius * 2; y++) {
+          if ( ((x - radius) * (x - radius)) +
+               ((y - radius) * (y - radius)) <=
+               radius * radius) {
+            int px = ball.px - radius + x;
+            int py = ball.py - radius + y;
 
             // TODO: wrap circle around screen
             SDL_RenderDrawPoint(renderer, px, py);
@@ -184,21 +223,25 @@ drawBall2(SDL_Surface *surface,
 {
     // setColor(renderer, ball.color);
 
+    float radius = Ball_Radius(&ball);
+
     // diameter is radius * 2
-    for (int x = 0; x < ball.radius * 2; x++) {
-        for (int y = 0; y < ball.radius * 2; y++) {
-          if ( ((x - ball.radius) * (x - ball.radius)) +
-               ((y - ball.radius) * (y - ball.radius)) <=
-               ball.radius * ball.radius) {
-            int px = ball.px - ball.radius + x;
-            int py = ball.py - ball.radius + y;
+    for (int x = 0; x < radius * 2; x++) {
+        for (int y = 0; y < radius * 2; y++) {
+          if ( ((x - radius) * (x - radius)) +
+               ((y - radius) * (y - radius)) <=
+               radius * radius) {
+            int px = ball.px - radius + x;
+            int py = ball.py - radius + y;
 
             // TODO: wrap circle around screen
             // SDL_RenderDrawPoint(renderer, px, py);
             SDL_Rect r = {.x = px, .y = py, .w = 1, .h = 1};
             uint32_t color = 
-                ((colors[ball.color].r << 24) | (colors[ball.color].g << 16) |
-                 (colors[ball.color].b << 8) | colors[ball.color].a);
+                ((colors[Ball_Color(&ball)].r << 24) |
+                 (colors[Ball_Color(&ball)].g << 16) |
+                 (colors[Ball_Color(&ball)].b << 8) |
+                 colors[Ball_Color(&ball)].a);
             SDL_FillRect(surface, &r, color);
 
           }
@@ -206,32 +249,6 @@ drawBall2(SDL_Surface *surface,
     }
 }
 
-float clamp(float v,
-            float min,
-            float max) {
-    if (v < min) return min;
-    if (v > max) return max;
-    return v;
-}
-
-bool circleRectCollide(SDL_Point circle,
-                       float r,
-                       SDL_Rect rect)
-{
-    float closestX = clamp(circle.x, rect.x, rect.x + rect.w);
-    float closestY = clamp(circle.y, rect.y, rect.y + rect.h);
-
-    // this gets the distance form the center of the circle to a side of a
-    // rectangle. It could be negative or positive. Because we are squaring them
-    // it doesn't matter.
-    float dx = circle.x - closestX;
-    float dy = circle.y - closestY;
-
-    // use the dot product to determine collision
-    return (dx*dx + dy*dy) <= (r*r);
-}
-
-
 static uint8_t
 updateNothing(Game *game,
            float seconds,
@@ -244,37 +261,300 @@ updateNothing(Game *game,
 }
 
 void
-worldBoundry(Game *game, Ball *ball)
+drawCursor(SDL_Renderer *renderer, SDL_Point p) {
+    SDL_Rect r = {
+        .x = p.x - 5,
+        .y = p.y - 5,
+        .w = 15,
+        .h = 15
+    };
+    setColor(renderer, COLOR_WHITE);
+    SDL_RenderFillRect(renderer, &r);
+}
+
+SDL_Rect
+ballRect(const Ball *b)
+// everything drawCircle or drawBall can touch
 {
-    int padding = 1;
+    float radius = Ball_Radius(b);
+
+    return (SDL_Rect) {
+        .x = b->px - radius - 2,
+        .y = b->py - radius - 2,
+        .w = radius * 2 + 6,
+        .h = radius * 2 + 6
+    };
+}
 
-    if (ball->px - ball->radius <= 0) {
-        ball->px = ball->radius + padding;
+SDL_Rect
+cursorRect(SDL_Point p)
+{
+    return (SDL_Rect) {.x = p.x - 5, .y = p.y - 5, .w = 15, .h = 15};
+}
+
+SDL_Rect
+lineRect(int x1,
+         int y1,
+         int x2,
+         int y2)
+{
+    return (SDL_Rect) {
+        .x = (x1 < x2 ? x1 : x2) - 1,
+        .y = (y1 < y2 ? y1 : y2) - 1,
+        .w = abs(x2 - x1) + 3,
+        .h = abs(y2 - y1) + 3
+    };
+}
+
+uint32_t
+ghosts(const Game *game,
+       SDL_Rect r,
+       SDL_Point *offsets)
+// Where something drawn at r has to be drawn when the world wraps: where it
+// is, and moved a screen over for every edge it crosses so the part hanging
+// off one side shows on the other. Only the edges it really crosses, a ball
+// in a corner is drawn four times, one near an edge twice. Returns how many
+// offsets, at most 4.
+{
+    int w = game->screen_rect.w;
+    int h = game->screen_rect.h;
+    int sx = (r.x < 0) ? w : (r.x + r.w > w) ? -w : 0;
+    int sy = (r.y < 0) ? h : (r.y + r.h > h) ? -h : 0;
+    uint32_t count = 0;
+
+    offsets[count++] = (SDL_Point) {0, 0};
+    if (!game->world.wrap) return count;
+    if (sx) offsets[count++] = (SDL_Point) {sx, 0};
+    if (sy) offsets[count++] = (SDL_Point) {0, sy};
+    if (sx && sy) offsets[count++] = (SDL_Point) {sx, sy};
+    return count;
+}
+
+void
+addDirty(Game *game,
+         SDL_Rect r)
+// with the ghosts of r
+{
+    SDL_Point offsets[4];
+    uint32_t count = ghosts(game, r, offsets);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        SDL_Rect moved = r;
+        moved.x += offsets[i].x;
+        moved.y += offsets[i].y;
+        Dirty_Add(&game->dirty, moved);
     }
+}
+
+bool
+flinging(int selected,
+         Mouse mouse)
+{
+    return mouse.down && mouse.button == SDL_BUTTON_RIGHT && selected >= 0;
+}
+
+void
+drawScene(Game *game,
+          SDL_Renderer *renderer,
+          int selected,
+          Mouse mouse)
+// Draws everything with the renderer. Does not clear.
+{
+    World *world = &game->world;
+    const Obstacles *obstacles = &world->obstacles;
+
+    setColor(renderer, COLOR_GREY);
+    for (uint32_t i = 0; i < obstacles->count; ++i) {
+        const Obstacle *o = &obstacles->items[i];
+
+        if (o->kind == OBSTACLE_SEGMENT) {
+            SDL_RenderDrawLine(renderer, o->x0, o->y0, o->x1, o->y1);
+            continue;
+        }
 
-    if (ball->py - ball->radius <= 0) {
-        ball->py = ball->radius + padding;
+        SDL_Rect r = {
+            .x = o->x0,
+            .y = o->y0,
+            .w = o->x1 - o->x0,
+            .h = o->y1 - o->y0
+        };
+        SDL_RenderFillRect(renderer, &r);
     }
 
-    if (ball->px + ball->radius >= game->screen_rect.w) {
-        ball->px = game->screen_rect.w - ball->radius - padding;
+    for (uint32_t i = 0; i < world->ball_count; ++i) {
+        SDL_Point offsets[4];
+        uint32_t count = ghosts(game, ballRect(&world->balls[i]), offsets);
+
+        for (uint32_t j = 0; j < count; ++j) {
+            Ball b1 = world->balls[i];
+            b1.px += offsets[j].x;
+            b1.py += offsets[j].y;
+
+            if ((int)world->ball_ids[i] == selected) drawBall(renderer, b1);
+            else drawCircle(renderer, game->screen_rect, Ball_Radius(&b1),
+                            b1.px, b1.py, 2, Ball_Color(&b1));
+        }
     }
 
-    if (ball->py + ball->radius >= game->screen_rect.h) {
-        ball->py = game->screen_rect.h - ball->radius - padding;
+    if (flinging(selected, mouse)) {
+        Ball *b = World_Ball(world, selected);
+        setColor(renderer, COLOR_WHITE);
+        SDL_RenderDrawLine(renderer, b->px, b->py, mouse.p.x, mouse.p.y);
     }
+    if (selected < 0 && !game->headless) drawCursor(renderer, mouse.p);
+}
+
+uint32_t
+mapColor(Game *game,
+         uint8_t color)
+{
+    return SDL_MapRGBA(game->backbuffer->format, colors[color].r,
+                       colors[color].g, colors[color].b, colors[color].a);
 }
 
 void
-drawCursor(SDL_Renderer *renderer, SDL_Point p) {
-    SDL_Rect r = {
-        .x = p.x - 5,
-        .y = p.y - 5,
-        .w = 15,
-        .h = 15
-    };
-    setColor(renderer, COLOR_WHITE);
-    SDL_RenderFillRect(renderer, &r);
+rasterScene(Game *game,
+            int selected,
+            Mouse mouse)
+// The same as drawScene, as shapes for the raster.
+{
+    World *world = &game->world;
+    const Obstacles *obstacles = &world->obstacles;
+    Raster *raster = &game->raster;
+    uint32_t grey = mapColor(game, COLOR_GREY);
+    uint32_t white = mapColor(game, COLOR_WHITE);
+
+    Raster_Clear(raster);
+
+    for (uint32_t i = 0; i < obstacles->count; ++i) {
+        const Obstacle *o = &obstacles->items[i];
+
+        if (o->kind == OBSTACLE_SEGMENT)
+            Raster_Segment(raster, o->x0, o->y0, o->x1, o->y1, grey);
+        else
+            Raster_Rect(raster, o->x0, o->y0, o->x1 - o->x0, o->y1 - o->y0,
+                        grey);
+    }
+
+    for (uint32_t i = 0; i < world->ball_count; ++i) {
+        Ball *b = &world->balls[i];
+        uint32_t color = mapColor(game, Ball_Color(b));
+        SDL_Point offsets[4];
+        uint32_t count = ghosts(game, ballRect(b), offsets);
+
+        // the raster clips, so a ghost only costs the part that shows
+        for (uint32_t j = 0; j < count; ++j) {
+            float x = b->px + offsets[j].x;
+            float y = b->py + offsets[j].y;
+
+            if ((int)world->ball_ids[i] == selected)
+                Raster_Disc(raster, x, y, Ball_Radius(b), color);
+            else Raster_Ring(raster, x, y, Ball_Radius(b), 2, color);
+        }
+    }
+
+    if (flinging(selected, mouse)) {
+        Ball *b = World_Ball(world, selected);
+        Raster_Segment(raster, b->px, b->py, mouse.p.x, mouse.p.y, white);
+    }
+    if (selected < 0) {
+        SDL_Rect r = cursorRect(mouse.p);
+        Raster_Rect(raster, r.x, r.y, r.w, r.h, white);
+    }
+}
+
+void
+drawDirty(Game *game,
+          int selected,
+          Mouse mouse)
+// Works out what moved since last frame, redraws only those parts of the
+// backbuffer and uploads only them to the screen texture. Balls that did not
+// move are not touched at all.
+{
+    World *world = &game->world;
+    Dirty *dirty = &game->dirty;
+    SDL_Rect none = {0};
+
+    dirty->count = 0;
+    if (game->redraw) {
+        Dirty_Add(dirty, game->screen_rect);
+        game->redraw = false;
+    }
+
+    // a ball looks different while it is selected
+    if (selected != game->drawn_selected) {
+        if (selected >= 0) addDirty(game, game->drawn[selected]);
+        if (game->drawn_selected >= 0)
+            addDirty(game, game->drawn[game->drawn_selected]);
+        game->drawn_selected = selected;
+    }
+
+    for (uint32_t i = 0; i < world->ball_count; ++i) {
+        SDL_Rect r = ballRect(&world->balls[i]);
+        SDL_Rect *drawn = &game->drawn[world->ball_ids[i]];
+
+        if (SDL_RectEquals(&r, drawn)) continue;
+        addDirty(game, *drawn);
+        addDirty(game, r);
+        *drawn = r;
+    }
+
+    SDL_Rect cursor = (selected < 0) ? cursorRect(mouse.p) : none;
+    if (!SDL_RectEquals(&cursor, &game->drawn_cursor)) {
+        Dirty_Add(dirty, game->drawn_cursor);
+        Dirty_Add(dirty, cursor);
+        game->drawn_cursor = cursor;
+    }
+
+    SDL_Rect line = none;
+    if (flinging(selected, mouse)) {
+        Ball *b = World_Ball(world, selected);
+        line = lineRect(b->px, b->py, mouse.p.x, mouse.p.y);
+    }
+    if (!SDL_RectEquals(&line, &game->drawn_line)) {
+        Dirty_Add(dirty, game->drawn_line);
+        Dirty_Add(dirty, line);
+        game->drawn_line = line;
+    }
+
+    // every tile under a dirty rectangle is drawn again, on all threads
+    rasterScene(game, selected, mouse);
+    Raster_Draw(&game->raster, dirty->rects, dirty->count,
+                mapColor(game, COLOR_BLACK));
+
+    for (uint32_t i = 0; i < dirty->count; ++i) {
+        SDL_Rect *r = &dirty->rects[i];
+        uint8_t *pixels = (uint8_t *)game->backbuffer->pixels +
+                          r->y * game->backbuffer->pitch + r->x * 4;
+        SDL_UpdateTexture(game->screen, r, pixels, game->backbuffer->pitch);
+    }
+
+    SDL_RenderCopy(game->renderer, game->screen, NULL, NULL);
+}
+
+static void
+drawHud(Game *game)
+// Over everything else, straight to the renderer, so it never makes the
+// backbuffer dirty.
+{
+    World *world = &game->world;
+    Hud *hud = &game->hud;
+    int y = 4;
+
+    Hud_Begin(hud);
+    y = Hud_Print(hud, 4, y, "%.0f fps", hud->fps);
+    y = Hud_Print(hud, 4, y, "step %.3f ms, %u substeps",
+                  game->step_ticks * 1000.0 / hud->frequency, world->substeps);
+    y = Hud_Print(hud, 4, y, "balls %u", world->ball_count);
+    y = Hud_Print(hud, 4, y, "contacts %u", world->contact_count);
+
+    // only begins are kept, each is a new hit
+    uint32_t hits;
+    World_Events(world, &hits);
+    y = Hud_Print(hud, 4, y, "hits %u", hits);
+    y = Hud_Print(hud, 4, y, "sleeping %u",
+                  world->ball_count - world->moving);
+    Hud_Draw(hud, game->renderer);
 }
 
 static uint8_t
@@ -285,17 +565,9 @@ updateMain(Game *game,
            Mouse mouse,
            bool keydown)
 {
-    static float elapsedTime = 0;
-    static int selected = -1;
-
-    // Ball *colliding[BALL_DISTINCT_UNORDERED_PAIRS] = {0};
-    game->balls_colliding  = NULL;
-    game->collision_count = 0;
-
+    static int selected = -1; // ball id
 
-    // game->ball_distinct_unordered_pairs is the total number of possible
-    // collisions, it is multiplied was two because there needed to be two values
-    // for each collision, a ball at the target ball
+    World *world = &game->world;
 
     // TODO
     // Add a middle click feature that lets you look around. Then you could see
@@ -305,14 +577,14 @@ updateMain(Game *game,
     // issues arise when mouse movement is too fast
     // don't check mouse click more than needed
     if(mouse.button == SDL_BUTTON_LEFT && (selected < 0)) {
-        for (int i = 0; i < BALL_COUNT; ++i) {
-            Ball *b = &game->balls[i];
-            if (pointInBall(*b, mouse.p)) selected = i;
+        for (uint32_t i = 0; i < world->ball_count; ++i) {
+            Ball *b = &world->balls[i];
+            if (pointInBall(*b, mouse.p)) selected = world->ball_ids[i];
         }
     }
 
     if((!mouse.down) && (mouse.button == SDL_BUTTON_RIGHT) && (selected >= 0)) {
-        Ball *b = &game->balls[selected];
+        Ball *b = World_Ball(world, selected);
         b->vx = 5.0f * (b->px - (float)mouse.p.x);
         b->vy = 5.0f * (b->py - (float)mouse.p.y);
     }
@@ -320,130 +592,34 @@ updateMain(Game *game,
     if (!mouse.down) selected = -1;
 
     if(selected >= 0 && mouse.button != SDL_BUTTON_RIGHT) {
-        elapsedTime = 0;
-        Ball *b = &game->balls[selected];
+        Ball *b = World_Ball(world, selected);
         b->px = mouse.p.x;
         b->py = mouse.p.y;
     }  
 
-    for (int i = 0; i < BALL_COUNT; ++i) {
-        Ball *b1 = &game->balls[i];
-        // drag
-        b1->ax = -b1->vx * 0.8f;
-        b1->ay = -b1->vy * 0.8f;
-
-        b1->vx += b1->ax * elapsedTime;
-        b1->vy += b1->ay * elapsedTime;
-        b1->px += b1->vx * elapsedTime;
-        b1->py += b1->vy * elapsedTime;
-
-        // wrap around screen
-        // Looks really bad, I'm removing this
-        // if (b1->px < 0) b1->px += (float)game->screen_rect.w;
-        // if (b1->px >= game->screen_rect.w) b1->px -= (float)game->screen_rect.w;
-        // if (b1->py < 0) b1->py += (float)game->screen_rect.h;
-        // if (b1->py >= game->screen_rect.h) b1->py -= (float)game->screen_rect.h;
-
-        if (fabs(b1->vx * b1->vx + b1->vy * b1->vy) < 0.01f) {
-            b1->vx = 0;
-            b1->vy = 0;
-        }
-
-    }
-
-    setColor(game->renderer, COLOR_BLACK);
-    SDL_RenderClear(game->renderer);
-
-    for (int i = 0; i < BALL_COUNT; ++i) {
-        Ball *b1 = &game->balls[i];
-        if (i == selected) drawBall(game->renderer, *b1);
-        else drawCircle(game->renderer, game->screen_rect, b1->radius, b1->px,
-                        b1->py, 2, b1->color);
-        
+    Alloc_Phase(FRAME_STEP);
+    Trace_Begin(&game->trace, "step");
+    uint64_t start = SDL_GetPerformanceCounter();
+    // exported frames are 1/fps apart in the video however long they take
+    World_Step(world, game->headless ? 1.0f / game->fps : game->pacer.seconds);
+    game->step_ticks = SDL_GetPerformanceCounter() - start;
+    Trace_End(&game->trace, "step");
+    Publish_Frame(&game->publish, world, game->palette);
+
+    Alloc_Phase(FRAME_DRAW);
+    Trace_Begin(&game->trace, "draw");
+    if (world->perf) Perf_Begin(world->perf);
+    // exported frames are drawn whole, the export thread wants all of them
+    if (game->headless) {
+        setColor(game->renderer, COLOR_BLACK);
+        SDL_RenderClear(game->renderer);
+        drawScene(game, game->renderer, selected, mouse);
+    } else {
+        drawDirty(game, selected, mouse);
+        drawHud(game);
     }
-
-    // TODO
-    // set up a list of values that will not conflict for i and j in gameInit
-
-    // TODO
-    // there is an error were the collision_count varaible will not reset to
-    // zero
-    for (int i = 0; i < BALL_COUNT; ++i) {
-        Ball *b1 = &game->balls[i];
-
-        for (int j = i + 1; j < BALL_COUNT; ++j) {
-            Ball *b2 = &game->balls[j];
-
-            if (!ballCollide(*b1, *b2)) continue;
-                game->balls_colliding = calloc(sizeof(Ball *),
-                                        (game->collision_count + 2));
-                END((!game->balls_colliding), "calloc()", "could not allocate game->balls_colliding()" );
-                game->balls_colliding[game->collision_count++] = b1;
-                game->balls_colliding[game->collision_count++] = b2;
-                float distance = fabs(getHyp(b1->px, b1->py, b2->px, b2->py));
-
-                float overlap = (distance - b1->radius - b2->radius);
-
-                if (distance == 0) continue;
-
-                b1->px -= overlap * (b1->px - b2->px) / distance;
-                b1->py -= overlap * (b1->py - b2->py) / distance;
-                b2->px += overlap * (b1->px - b2->px) / distance;
-                b2->py += overlap * (b1->py - b2->py) / distance;
-            // }
-        }
-    }
-    // printf("collision count: %d\n", game->collision_count);
-    for (int i = 0; i < game->collision_count; ++i) {
-        Ball *b1 = game->balls_colliding[i];
-        Ball *b2 = game->balls_colliding[i + 1];
-        if (!b1 || !b2) continue;
-        float distance = getHyp(b1->px, b1->py, b2->px, b2->py);
-
-        // normal
-        float nx = (b2->px - b1->px) / distance;
-        float ny = (b2->py - b1->py) / distance;
-
-        // tangent
-        float tx = -ny;
-        float ty = nx;
-
-        float dpTan1 = b1->vx * tx + b1->vy * ty;
-        float dpTan2 = b2->vx * tx + b2->vy * ty;
-
-        float dpNorm1 = b1->vx * nx + b1->vy * ny;
-        float dpNorm2 = b2->vx * nx + b2->vy * ny;
-
-        float m1 =
-            (dpNorm1 * (b1->mass - b2->mass) + 2.0f * b2->mass * dpNorm2)
-            / (b1->mass + b2->mass);
-
-        float m2 =
-            (dpNorm2 * (b2->mass - b1->mass) + 2.0f * b1->mass * dpNorm1)
-            / (b1->mass + b2->mass);
-
-        b1->vx = tx * dpTan1 + nx * m1;
-        b1->vy = ty * dpTan1 + ny * m1;
-        b2->vx = tx * dpTan2 + nx * m2;
-        b2->vy = ty * dpTan2 + ny * m2;
-        
-    }
-
-    if((mouse.down) && (mouse.button == SDL_BUTTON_RIGHT) && (selected >= 0)) {
-        Ball *b = &game->balls[selected];
-        setColor(game->renderer, COLOR_WHITE);
-        SDL_RenderDrawLine(game->renderer, b->px, b->py, mouse.p.x, mouse.p.y);
-    }
-    if (selected < 0) drawCursor(game->renderer, mouse.p);
-
-    if (game->collision_count > 0)  {
-        // I do not have free each individual ball in ball colliding because
-        // they are all on the stack
-        free(game->balls_colliding);
-        game->balls_colliding = NULL;
-    }
-
-    elapsedTime += 0.0008f;
+    if (world->perf) Perf_End(world->perf, PERF_DRAW, world->ball_count);
+    Trace_End(&game->trace, "draw");
 
     return UPDATE_MAIN;
 }
@@ -458,17 +634,16 @@ Game_Update(Game *game)
     uint64_t frame = 0;
     bool quit = false;
     bool keydown = false;
-    float mspf = (1.0f / (float)game->fps) * 1000.0f;
     SDL_Event event;
     SDL_KeyCode key = 0;
     Update_callback update;
-    uint32_t ticks_start = SDL_GetTicks();
-    Mouse mouse;
+    Mouse mouse = {0};
 
-    // TODO
-    // add backbuffer
+    // set BALLS_VSYNC to let the display pace the frames
+    Pacer_Init(&game->pacer, game->fps, getenv("BALLS_VSYNC") != NULL);
 
     while (!quit) {
+        Trace_Begin(&game->trace, "frame");
 
         // Place update functions here
         switch (update_id) {
@@ -476,6 +651,8 @@ Game_Update(Game *game)
             case UPDATE_NOTHING: update = updateNothing; break;
         }
 
+        Alloc_Phase(FRAME_EVENTS);
+        Trace_Begin(&game->trace, "events");
         while (SDL_PollEvent(&event)) {
 
             switch (event.type) {
@@ -507,49 +684,168 @@ Game_Update(Game *game)
                 case SDL_QUIT: quit = true; break;
             }
         }
+        Trace_End(&game->trace, "events");
 
+        Trace_Begin(&game->trace, "update");
         update_id = update(game, SDL_GetTicks(), frame, key, mouse,keydown);
+        Trace_End(&game->trace, "update");
+
+        Alloc_Phase(FRAME_PRESENT);
+        Trace_Begin(&game->trace, "present");
+        SDL_RenderPresent(game->renderer);
+        Trace_End(&game->trace, "present");
+        Alloc_Phase(ALLOC_NONE);
+
+        // sleeps until the next frame instead of spinning the loop
+        Trace_Begin(&game->trace, "wait");
+        Pacer_Wait(&game->pacer);
+        Trace_End(&game->trace, "wait");
+        Trace_End(&game->trace, "frame");
+        Alloc_Frame();
+        frame++;
+    }
+}
+
+bool
+Game_Export(Game *game,
+            uint32_t frames,
+            const char *path)
+// Runs the update callbacks for a fixed number of frames with no window or
+// input, as fast as they go, and hands every frame to the export thread.
+{
+    static Export export;
+    uint8_t update_id = 0;
+    Update_callback update;
+    Mouse mouse = {0};
 
-        if ((SDL_GetTicks() - ticks_start) >= mspf) {
-            ticks_start = SDL_GetTicks();
-            // SDL_SetRenderDrawBlendMode(game->renderer, SDL_BLENDMODE_NONE);
-            // SDL_Texture *texture =
-            //     SDL_CreateTextureFromSurface(game->renderer, game->backbuffer);
-            // SDL_RenderCopyEx(game->renderer, texture, NULL, &game->screen_rect,
-            //                 0, NULL, SDL_FLIP_NONE);
-            SDL_RenderPresent(game->renderer);
-            // SDL_DestroyTexture(texture);
+    END(!Export_Start(&export, path, game->screen_rect.w, game->screen_rect.h),
+        "Export_Start()", SDL_GetError());
+
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        Trace_Begin(&game->trace, "frame");
+        game->backbuffer = export.frames[export.current];
+        game->renderer = export.renderers[export.current];
+
+        switch (update_id) {
+            case UPDATE_MAIN: update = updateMain; break;
+            case UPDATE_NOTHING: update = updateNothing; break;
         }
 
-        frame++;
+        Trace_Begin(&game->trace, "update");
+        update_id = update(game, frame / (float)game->fps, frame, 0, mouse,
+                           false);
+        Trace_End(&game->trace, "update");
+
+        // waits if the writer is still busy with the other frame
+        Alloc_Phase(FRAME_PRESENT);
+        Trace_Begin(&game->trace, "submit");
+        Export_Submit(&export);
+        Trace_End(&game->trace, "submit");
+        Alloc_Phase(ALLOC_NONE);
+        Trace_End(&game->trace, "frame");
+        Alloc_Frame();
     }
+
+    // the surfaces and renderers belong to the export
+    game->backbuffer = NULL;
+    game->renderer = NULL;
+
+    return Export_Stop(&export);
 }
 
-void createBalls(Game *game) {
-    for (int i = 0; i < BALL_COUNT; ++i) {
-        Ball *b = &game->balls[i];
-        b->vx = 0;
-        b->vy = 0;
-        b->ax = 0;
-        b->ay = 0;
-        b->radius = ((rand() / (float)RAND_MAX) * (game->ball_size_max -
-                    game->ball_size_min)) + game->ball_size_min;
+void
+createBalls(Game *game,
+            uint32_t seed)
+{
+    World *world = &game->world;
+
+    END(!World_Init(world, &game->arena, BALL_COUNT, game->screen_rect.w,
+                    game->screen_rect.h),
+        "World_Init()", "arena is too small");
+
+    // set BALLS_LEVEL to a level file to add obstacles
+    // set BALLS_WRAP for a world without edges
+    world->wrap = getenv("BALLS_WRAP") != NULL;
+    // set BALLS_REORDER to sort the balls in memory every that many steps
+    const char *reorder = getenv("BALLS_REORDER");
+    if (reorder) world->reorder_every = strtoul(reorder, NULL, 10);
+    END(!World_InitObstacles(world, &game->arena, getenv("BALLS_LEVEL")),
+        "World_InitObstacles()", "could not load the level");
+
+    // last color is black
+    World_Scatter(world, seed, game->ball_size_min, game->ball_size_max,
+                  game->initial_speed, COLOR_SIZE - 2);
+
+    if (game->perf.enabled) world->perf = &game->perf;
+}
 
-        b->px = (rand() / (float)RAND_MAX) * (float)game->screen_rect.w;
+void
+formatByteOrder(FILE *out, const Record *record)
+{
+    fprintf(out, "big ending = %s\n", record->values[0] ? "true": "False");
+}
+
+static void
+startPublish(Game *game)
+// set BALLS_PUBLISH to a shared memory name, like /balls, to watch the game
+// from other processes
+{
+    const char *name = getenv("BALLS_PUBLISH");
 
-        b->py = (rand() / (float)RAND_MAX) * (float)game->screen_rect.h;
+    if (name)
+        END(!Publish_Start(&game->publish, name, game->world.ball_count,
+                           game->world.width, game->world.height),
+            "Publish_Start()", "could not make the shared memory");
+}
 
-        b->color = (rand() / (float)RAND_MAX) * ((float)COLOR_SIZE - 2);
+static volatile sig_atomic_t stopped;
 
-        b->mass = b->radius * 10;
+static void
+stop(int signal)
+{
+    (void)signal;
+    stopped = 1;
+}
+
+bool
+Game_Publish(Game *game,
+             const char *name)
+// Runs the world with no window at the game's frame rate and publishes every
+// step until interrupted. Watch it with ./viewer.
+{
+    World *world = &game->world;
+
+    // with BALLS_PUBLISH set Game_Init has started one already, under that
+    // name
+    if (!game->publish.header &&
+        !Publish_Start(&game->publish, name, world->ball_count,
+                       world->width, world->height))
+        return false;
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    Pacer_Init(&game->pacer, game->fps, false);
+
+    while (!stopped) {
+        Alloc_Phase(FRAME_STEP);
+        Trace_Begin(&game->trace, "step");
+        World_Step(world, 1.0f / game->fps);
+        Trace_End(&game->trace, "step");
+        Publish_Frame(&game->publish, world, game->palette);
+        Alloc_Phase(ALLOC_NONE);
+
+        Pacer_Wait(&game->pacer);
+        Alloc_Frame();
     }
 
+    return true;
 }
 
 Game *
-Game_Init()
+Game_Init(bool headless)
 // All the variable and data initialization needed for SDL and perhaps game
-// variables
+// variables. A headless game has no window or renderer, Game_Export sets them
+// up.
 {
     static Game game = {
         .screen_rect = {.x = 0, .y = 0, .w = 800, .h = 800},
@@ -559,12 +855,70 @@ Game_Init()
         .backbuffer = NULL,
     };
 
-    END(SDL_Init(SDL_INIT_VIDEO) != 0, "Could not create texture",
-        SDL_GetError());
+    game.headless = headless;
+
+    END(SDL_Init(headless ? 0 : SDL_INIT_VIDEO) != 0,
+        "Could not create texture", SDL_GetError());
 
     END(TTF_Init() != 0, "Could not initialize TTF", TTF_GetError());
 
+    static const Telemetry_formatter formatters[TELEMETRY_SIZE] = {
+        [TELEMETRY_BYTE_ORDER] = formatByteOrder,
+    };
+
+    // set BALLS_TELEMETRY to a file name to log there instead of the
+    // terminal. Exported frames may be going to stdout, so log to stderr.
+    const char *log = getenv("BALLS_TELEMETRY");
+    if (!log && headless) log = "/dev/stderr";
+    END(!Telemetry_Start(&game.telemetry, log, formatters, TELEMETRY_SIZE),
+        "Telemetry_Start()", "could not start telemetry");
+
+    for (uint32_t i = 0; i < COLOR_SIZE; ++i)
+        game.palette[i] = colors[i].r << 24 | colors[i].g << 16 |
+                          colors[i].b << 8 | colors[i].a;
 
+    // print system information
+    float big_endian = SDL_BYTEORDER == SDL_BIG_ENDIAN;
+    Telemetry_Push(&game.telemetry, TELEMETRY_BYTE_ORDER, 0, &big_endian, 1);
+
+    // set BALLS_PERF to count cycles, cache and branch misses per phase
+    static const char *const phases[] = {
+        [WORLD_REORDER] = "reorder",
+        [WORLD_INTEGRATE] = "integrate",
+        [WORLD_BROADPHASE] = "broadphase",
+        [WORLD_NARROWPHASE] = "narrowphase",
+        [WORLD_RESOLVE] = "resolve",
+        [PERF_DRAW] = "draw",
+    };
+    if (getenv("BALLS_PERF")) Perf_Init(&game.perf, phases, PERF_DRAW + 1);
+
+    // In a build with allocation tracking, set BALLS_ALLOC_STRICT to abort on
+    // any allocation in the step or draw once warmed up
+    const char *const frame_phases[] = {
+        [FRAME_EVENTS] = "events",
+        [FRAME_STEP] = "step",
+        [FRAME_DRAW] = "draw",
+        [FRAME_PRESENT] = headless ? "submit" : "present",
+    };
+    Alloc_Init(frame_phases, FRAME_PHASES, getenv("BALLS_ALLOC_STRICT") ?
+               1u << FRAME_STEP | 1u << FRAME_DRAW : 0);
+
+    // set BALLS_TRACE to a file name to record a timeline of every frame
+    END(!Trace_Start(&game.trace, getenv("BALLS_TRACE")), "Trace_Start()",
+        "could not allocate the trace buffer");
+
+    END(!Arena_Init(&game.arena, World_Size(BALL_COUNT) +
+                    World_ObstaclesSize(getenv("BALLS_LEVEL")) +
+                    World_EventsSize(BALL_COUNT) +
+                    BALL_COUNT * sizeof(SDL_Rect) + 1024),
+        "Arena_Init()", "could not allocate the arena");
+
+    if (headless) {
+        game.initial_speed = EXPORT_BALL_SPEED;
+        createBalls(&game, time(NULL));
+        startPublish(&game);
+        return &game;
+    }
 
     game.window = SDL_CreateWindow("balls", SDL_WINDOWPOS_UNDEFINED, 
                      SDL_WINDOWPOS_UNDEFINED, game.screen_rect.w, 
@@ -573,7 +927,9 @@ Game_Init()
     END(game.window == NULL, "Could not create window", SDL_GetError());
 
     game.renderer =
-        SDL_CreateRenderer(game.window, 0, SDL_RENDERER_ACCELERATED);
+        SDL_CreateRenderer(game.window, 0, SDL_RENDERER_ACCELERATED |
+                           (getenv("BALLS_VSYNC") ?
+                            SDL_RENDERER_PRESENTVSYNC : 0));
 
     END(game.renderer == NULL, "Could not create renderer", SDL_GetError());
 
@@ -588,12 +944,34 @@ Game_Init()
     // fill backbuffer with black
     SDL_FillRect(game.backbuffer, &game.screen_rect, 0x00000000);
 
-    // print system information
-    printf("big ending = %s\n", SDL_BYTEORDER == SDL_BIG_ENDIAN ? 
-                                "true": "False");
-
-    srand(time(NULL));
-    createBalls(&game);
+    game.screen = SDL_CreateTexture(game.renderer, SDL_PIXELFORMAT_RGBA8888,
+                                    SDL_TEXTUREACCESS_STREAMING,
+                                    game.screen_rect.w, game.screen_rect.h);
+    END(game.screen == NULL, "Could not create texture", SDL_GetError());
+
+    createBalls(&game, time(NULL));
+    startPublish(&game);
+    END(!World_InitEvents(&game.world, &game.arena, WORLD_EVENT_BEGIN),
+        "World_InitEvents()", "arena is too small");
+
+    game.drawn = Arena_Alloc(&game.arena, BALL_COUNT * sizeof(SDL_Rect));
+    END(game.drawn == NULL, "Arena_Alloc()", "arena is too small");
+    game.drawn_selected = -1;
+
+    END(!Pool_Init(&game.pool, 0), "Pool_Init()", "could not start threads");
+    // obstacles, balls with up to three ghosts each when the world wraps, the
+    // fling line and the cursor
+    END(!Raster_Init(&game.raster, game.backbuffer,
+                     game.world.obstacles.count + 4 * BALL_COUNT + 2,
+                     &game.pool),
+        "Raster_Init()", "could not allocate the raster");
+    game.dirty.bounds = game.screen_rect;
+    game.redraw = true;
+
+    // set BALLS_FONT to draw the stats with another font, the HUD is left off
+    // if the font is not there
+    const char *font = getenv("BALLS_FONT");
+    Hud_Init(&game.hud, game.renderer, font ? font : HUD_FONT, HUD_FONT_SIZE);
 
     return &game;
 }
@@ -601,9 +979,23 @@ Game_Init()
 void
 Game_Quit(Game *game)
 {
-    if (game->collision_count > 0)  {
-        free(game->balls_colliding);
-        game->balls_colliding = NULL;
+    Telemetry_Stop(&game->telemetry);
+    Trace_Stop(&game->trace);
+    if (!game->headless) Pacer_Print(&game->pacer, "collisions");
+    if (game->world.perf) {
+        // stdout may be the exported frames
+        Perf_Print(game->world.perf, game->headless ? stderr : stdout,
+                   "collisions");
+        Perf_Free(game->world.perf);
+    }
+    Alloc_Print(game->headless ? stderr : stdout, "collisions");
+    if (game->publish.header) Publish_Close(&game->publish);
+    Arena_Free(&game->arena);
+    if (game->screen) SDL_DestroyTexture(game->screen);
+    Hud_Free(&game->hud);
+    if (game->raster.shapes) {
+        Raster_Free(&game->raster);
+        Pool_Free(&game->pool);
     }
     SDL_DestroyWindow(game->window);
     SDL_DestroyRenderer(game->renderer);
@@ -613,9 +1005,63 @@ Game_Quit(Game *game)
 }
 
 int
-main(void)
+main(int argc, char **argv)
 {
-    Game *game = Game_Init();
+    // balls batch SCENES OUT [THREADS], no SDL at all
+    if (argc >= 4 && strcmp(argv[1], "batch") == 0) {
+        return Batch_Run(argv[2], argv[3],
+                         argc >= 5 ? strtoul(argv[4], NULL, 10) : 0) ? 0 : 1;
+    }
+
+    // balls scale BALLS [STEPS] [THREADS], times the contact solver
+    if (argc >= 3 && strcmp(argv[1], "scale") == 0) {
+        return Batch_Scale(strtoul(argv[2], NULL, 10),
+                           argc >= 4 ? strtoul(argv[3], NULL, 10) : 200,
+                           argc >= 5 ? strtoul(argv[4], NULL, 10) : 0) ? 0 : 1;
+    }
+
+    // balls reorder BALLS [STEPS] [EVERY], times the grid with and without
+    // sorting the balls
+    if (argc >= 3 && strcmp(argv[1], "reorder") == 0) {
+        return Batch_Reorder(strtoul(argv[2], NULL, 10),
+                             argc >= 4 ? strtoul(argv[3], NULL, 10) : 200,
+                             argc >= 5 ? strtoul(argv[4], NULL, 10) : 16) ?
+               0 : 1;
+    }
+
+    // balls layout BALLS [STEPS], what a ball costs in this build
+    if (argc >= 3 && strcmp(argv[1], "layout") == 0) {
+        return Batch_Layout(strtoul(argv[2], NULL, 10),
+                            argc >= 4 ? strtoul(argv[3], NULL, 10) : 20) ?
+               0 : 1;
+    }
+
+    // balls slabs BALLS [PROCS] [STEPS], one world stepped by several
+    // processes
+    if (argc >= 3 && strcmp(argv[1], "slabs") == 0) {
+        return Slabs_Run(strtoul(argv[2], NULL, 10),
+                         argc >= 4 ? strtoul(argv[3], NULL, 10) : 4,
+                         argc >= 5 ? strtoul(argv[4], NULL, 10) : 200) ? 0 : 1;
+    }
+
+    // balls publish [NAME], no window, watch it with ./viewer [NAME]
+    if (argc >= 2 && strcmp(argv[1], "publish") == 0) {
+        Game *game = Game_Init(true);
+        bool ok = Game_Publish(game, argc >= 3 ? argv[2] : PUBLISH_NAME);
+        Game_Quit(game);
+        return ok ? 0 : 1;
+    }
+
+    // balls export FRAMES [PATH]
+    if (argc >= 3 && strcmp(argv[1], "export") == 0) {
+        Game *game = Game_Init(true);
+        bool ok = Game_Export(game, strtoul(argv[2], NULL, 10),
+                              argc >= 4 ? argv[3] : "-");
+        Game_Quit(game);
+        return ok ? 0 : 1;
+    }
+
+    Game *game = Game_Init(false);
     Game_Update(game);
     Game_Quit(game);
     return 0;
@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "world.h"
+#include "pool.h"
+#include "arena.h"
+
+typedef struct _Batch {
+    Scene *scenes;
+    Result *results;
+    uint32_t scene_count;
+    Arena *arenas; // one per worker
+} Batch;
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static size_t
+worldSize(uint32_t balls)
+{
+    return World_Size(balls) + World_ObstaclesSize(NULL) + 1024;
+}
+
+static void
+runScene(void *data,
+         uint32_t task,
+         uint32_t worker)
+{
+    Batch *batch = data;
+    const Scene *scene = &batch->scenes[task];
+    Result *result = &batch->results[task];
+    Arena *arena = &batch->arenas[worker];
+    World world;
+    double start = now();
+
+    Arena_Reset(arena);
+    if (!World_Init(&world, arena, scene->balls, scene->width,
+                    scene->height) ||
+        !World_InitObstacles(&world, arena, NULL)) {
+        result->ok = false;
+        return;
+    }
+
+    world.drag = scene->drag;
+    world.mass_factor = scene->mass_factor;
+    world.restitution = scene->restitution;
+    World_Scatter(&world, scene->seed, scene->radius_min, scene->radius_max,
+                  scene->speed, 1);
+
+    result->energy_start = World_Energy(&world);
+    result->settle_time = 0;
+
+    for (uint32_t i = 0; i < scene->steps; ++i) {
+        World_Step(&world, scene->dt);
+        if (world.moving > 0) result->settle_time = (i + 1) * scene->dt;
+    }
+
+    result->contacts = world.contacts_total;
+    result->contacts_dropped = world.contacts_dropped;
+    result->substeps = world.substeps_total;
+    result->energy_end = World_Energy(&world);
+    result->ms = now() - start;
+    result->ok = true;
+}
+
+static uint32_t
+readScenes(const char *path,
+           Scene **scenes)
+{
+    FILE *file = fopen(path, "r");
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+    char line[512];
+
+    *scenes = NULL;
+    if (!file) return 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        Scene scene;
+        char *start = line + strspn(line, " \t");
+
+        if (*start == '#' || *start == '\n' || *start == '\0') continue;
+
+        int n = sscanf(start, "%63s %u %f %f %f %f %f %f %f %f %u %f %u",
+                       scene.name, &scene.balls, &scene.width, &scene.height,
+                       &scene.radius_min, &scene.radius_max, &scene.drag,
+                       &scene.mass_factor, &scene.restitution, &scene.speed,
+                       &scene.steps, &scene.dt, &scene.seed);
+        if (n != 13) {
+            fprintf(stderr, "%s: skipping bad scene: %s", path, start);
+            continue;
+        }
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            Scene *grown = realloc(*scenes, capacity * sizeof(Scene));
+            if (!grown) break;
+            *scenes = grown;
+        }
+        (*scenes)[count++] = scene;
+    }
+
+    fclose(file);
+    return count;
+}
+
+bool
+Batch_Run(const char *scenes_path,
+          const char *out_path,
+          uint32_t threads)
+{
+    Batch batch = {0};
+    Pool pool;
+    bool ok = false;
+    uint32_t largest = 0;
+
+    batch.scene_count = readScenes(scenes_path, &batch.scenes);
+    if (batch.scene_count == 0) {
+        fprintf(stderr, "%s: no scenes\n", scenes_path);
+        return false;
+    }
+
+    FILE *out = fopen(out_path, "w");
+    if (!out) {
+        free(batch.scenes);
+        return false;
+    }
+
+    batch.results = calloc(batch.scene_count, sizeof(Result));
+    if (!batch.results || !Pool_Init(&pool, threads)) goto done;
+
+    for (uint32_t i = 0; i < batch.scene_count; ++i)
+        if (batch.scenes[i].balls > largest) largest = batch.scenes[i].balls;
+
+    // every arena is big enough for the largest scene, so nothing is
+    // allocated once the runs start
+    batch.arenas = calloc(pool.worker_count, sizeof(Arena));
+    if (!batch.arenas) goto free_pool;
+    for (uint32_t i = 0; i < pool.worker_count; ++i)
+        if (!Arena_Init(&batch.arenas[i], worldSize(largest))) goto free_arenas;
+
+    double start = now();
+    Pool_Run(&pool, batch.scene_count, runScene, &batch);
+    double elapsed = now() - start;
+
+    fprintf(out, "name,balls,drag,mass,restitution,steps,substeps,settle_time,"
+            "contacts,contacts_dropped,energy_start,energy_end,ms\n");
+    for (uint32_t i = 0; i < batch.scene_count; ++i) {
+        const Scene *s = &batch.scenes[i];
+        const Result *r = &batch.results[i];
+
+        if (!r->ok) {
+            fprintf(stderr, "%s: could not run\n", s->name);
+            continue;
+        }
+
+        fprintf(out, "%s,%u,%g,%g,%g,%u,%lu,%g,%lu,%lu,%g,%g,%.3f\n",
+                s->name, s->balls, s->drag, s->mass_factor, s->restitution,
+                s->steps, (unsigned long)r->substeps, r->settle_time,
+                (unsigned long)r->contacts,
+                (unsigned long)r->contacts_dropped, r->energy_start,
+                r->energy_end, r->ms);
+    }
+
+    fprintf(stderr, "%u scenes on %u threads in %.1f ms\n", batch.scene_count,
+            pool.worker_count, elapsed);
+    ok = true;
+
+free_arenas:
+    for (uint32_t i = 0; i < pool.worker_count; ++i)
+        Arena_Free(&batch.arenas[i]);
+    free(batch.arenas);
+free_pool:
+    Pool_Free(&pool);
+done:
+    free(batch.results);
+    free(batch.scenes);
+    fclose(out);
+    return ok;
+}
+
+bool
+Batch_Scale(uint32_t balls,
+            uint32_t steps,
+            uint32_t threads)
+// Times the contact solver on a dense pile with 1, 2, 4 ... threads up to
+// threads (0 for one per CPU) and prints a table. The pile is the same for
+// every run, so the end energy has to be too.
+{
+    Arena arena;
+    // about 80% of the world is covered, so nearly every ball touches another
+    float side = sqrtf(balls) * 10;
+    double base = 0;
+    double energy = 0;
+
+    if (threads == 0) {
+        // -1 when it cannot tell
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus < 1 ? 1 : cpus;
+    }
+    if (!Arena_Init(&arena, worldSize(balls))) return false;
+
+    printf("%u balls, %u steps, %ld CPUs\n", balls, steps,
+           sysconf(_SC_NPROCESSORS_ONLN));
+    printf("threads  colours  contacts/step  solve ms/step  speedup  energy\n");
+
+    for (uint32_t t = 1; t <= threads; t *= 2) {
+        World world;
+        Pool pool;
+
+        Arena_Reset(&arena);
+        if (!World_Init(&world, &arena, balls, side, side)) {
+            Arena_Free(&arena);
+            return false;
+        }
+
+        // no edges, so the pile is just as dense everywhere
+        world.wrap = true;
+        if (!World_InitObstacles(&world, &arena, NULL) ||
+            !Pool_Init(&pool, t)) {
+            Arena_Free(&arena);
+            return false;
+        }
+
+        world.restitution = 0.5f;
+        World_Scatter(&world, 1, 4, 6, 50, 1);
+        if (t > 1) world.pool = &pool;
+
+        uint32_t colors = 0;
+        for (uint32_t i = 0; i < steps; ++i) {
+            World_Step(&world, 0.016f);
+            if (world.color_count > colors) colors = world.color_count;
+        }
+
+        double ms = world.solve_ns / 1e6 / steps;
+        if (t == 1) {
+            base = ms;
+            energy = World_Energy(&world);
+        }
+
+        printf("%7u  %7u  %13.0f  %13.3f  %7.2f  %s\n", pool.worker_count,
+               colors, world.contacts_total / (double)steps, ms, base / ms,
+               World_Energy(&world) == energy ? "same" : "DIFFERENT");
+        Pool_Free(&pool);
+    }
+
+    Arena_Free(&arena);
+    return true;
+}
+
+bool
+Batch_Reorder(uint32_t balls,
+              uint32_t steps,
+              uint32_t every)
+// Times broadphase and narrowphase on a loose pile that keeps moving, once with
+// the balls left in the order they were made and once sorted every `every`
+// steps. With BALLS_PERF set, the counters of each phase are printed too.
+{
+    static const char *const phases[] = {
+        [WORLD_REORDER] = "reorder",
+        [WORLD_INTEGRATE] = "integrate",
+        [WORLD_BROADPHASE] = "broadphase",
+        [WORLD_NARROWPHASE] = "narrowphase",
+        [WORLD_RESOLVE] = "resolve",
+    };
+    Arena arena;
+    // about a fifth of the world is covered
+    float side = sqrtf(balls) * 20;
+
+    if (!Arena_Init(&arena, worldSize(balls))) return false;
+
+    printf("%u balls, %u steps\n", balls, steps);
+    printf("sorted every  collide ms/step  step ms/step\n");
+
+    for (uint32_t run = 0; run < 2; ++run) {
+        World world;
+        Perf perf;
+        char label[16] = "never";
+
+        Arena_Reset(&arena);
+        if (!World_Init(&world, &arena, balls, side, side)) {
+            Arena_Free(&arena);
+            return false;
+        }
+
+        world.wrap = true;
+        if (!World_InitObstacles(&world, &arena, NULL)) {
+            Arena_Free(&arena);
+            return false;
+        }
+
+        // no drag, so the balls keep mixing and the order goes stale
+        world.drag = 0;
+        World_Scatter(&world, 1, 3, 6, 100, 1);
+        if (run == 1) {
+            world.reorder_every = every;
+            snprintf(label, sizeof(label), "%u", every);
+        }
+        if (getenv("BALLS_PERF") && Perf_Init(&perf, phases, WORLD_PHASES))
+            world.perf = &perf;
+
+        double start = now();
+        for (uint32_t i = 0; i < steps; ++i) World_Step(&world, 0.016f);
+        double ms = (now() - start) / steps;
+
+        printf("%12s  %15.3f  %12.3f\n", label,
+               world.collide_ns / 1e6 / steps, ms);
+        if (world.perf) {
+            Perf_Print(&perf, stdout, run ? "sorted" : "unsorted");
+            Perf_Free(&perf);
+        }
+    }
+
+    Arena_Free(&arena);
+    return true;
+}
+
+bool
+Batch_Layout(uint32_t balls,
+             uint32_t steps)
+// Steps a loose pile that keeps moving and prints what a ball costs in memory
+// and how fast a step goes, for the layout this was built with. Build once
+// with make and once with make COMPACT=1 to compare them.
+{
+    Arena arena;
+    World world;
+    // about a fifth of the world is covered
+    float side = sqrtf(balls) * 20;
+#ifdef WORLD_COMPACT
+    const char *layout = "compact";
+#else
+    const char *layout = "full";
+#endif
+
+    if (!Arena_Init(&arena, worldSize(balls))) return false;
+    if (!World_Init(&world, &arena, balls, side, side)) {
+        Arena_Free(&arena);
+        return false;
+    }
+
+    world.wrap = true;
+    if (!World_InitObstacles(&world, &arena, NULL)) {
+        Arena_Free(&arena);
+        return false;
+    }
+
+    // sorted like a world this big would be, the sort moves whole balls too
+    world.drag = 0;
+    world.reorder_every = 16;
+    World_Scatter(&world, 1, 3, 6, 100, 1);
+
+    double start = now();
+    for (uint32_t i = 0; i < steps; ++i) World_Step(&world, 0.016f);
+    double ms = (now() - start) / steps;
+
+    printf("%s layout, %u balls, %u steps\n", layout, balls, steps);
+    printf("Ball %zu bytes, world %.0f bytes per ball\n", sizeof(Ball),
+           (double)World_Size(balls) / balls);
+    printf("step %.3f ms, collide %.3f ms, solve %.3f ms, "
+           "%.1f million balls/s\n", ms, world.collide_ns / 1e6 / steps,
+           world.solve_ns / 1e6 / steps, balls / ms / 1000);
+    printf("%.2f contacts per ball, %lu dropped, energy %g\n",
+           world.contacts_total / (double)world.substeps_total / balls,
+           (unsigned long)world.contacts_dropped, World_Energy(&world));
+
+    Arena_Free(&arena);
+    return true;
+}
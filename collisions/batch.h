@@ -0,0 +1,50 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Runs many independent scenes without a window, spread over a thread pool,
+// and writes one line of results per scene. Each worker thread has its own
+// arena that is reset between scenes.
+//
+// Scenes are read one per line, blank lines and lines starting with # are
+// skipped:
+//
+//   name balls width height radius_min radius_max drag mass restitution
+//   speed steps dt seed
+
+#define BATCH_NAME_SIZE 64
+
+typedef struct _Scene {
+    char name[BATCH_NAME_SIZE];
+    uint32_t balls;
+    float width, height;
+    float radius_min, radius_max;
+    float drag;
+    float mass_factor;
+    float restitution;
+    float speed;
+    uint32_t steps;
+    float dt;
+    uint32_t seed;
+} Scene;
+
+typedef struct _Result {
+    bool ok;
+    double settle_time; // seconds until nothing moved anymore
+    uint64_t contacts;
+    uint64_t contacts_dropped;
+    uint64_t substeps; // over all steps
+    double energy_start;
+    double energy_end;
+    double ms; // wall clock time of the run
+} Result;
+
+bool Batch_Run(const char *scenes_path, const char *out_path,
+               uint32_t threads);
+bool Batch_Scale(uint32_t balls, uint32_t steps, uint32_t threads);
+bool Batch_Reorder(uint32_t balls, uint32_t steps, uint32_t every);
+bool Batch_Layout(uint32_t balls, uint32_t steps);
+
+#endif
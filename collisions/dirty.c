@@ -0,0 +1,68 @@
+#include "dirty.h"
+
+static int
+area(SDL_Rect r)
+{
+    return r.w * r.h;
+}
+
+static bool
+near(SDL_Rect a,
+     SDL_Rect b)
+{
+    return a.x - DIRTY_SLACK <= b.x + b.w && b.x - DIRTY_SLACK <= a.x + a.w &&
+           a.y - DIRTY_SLACK <= b.y + b.h && b.y - DIRTY_SLACK <= a.y + a.h;
+}
+
+static void
+removeRect(Dirty *dirty,
+           uint32_t i)
+{
+    dirty->rects[i] = dirty->rects[--dirty->count];
+}
+
+void
+Dirty_Add(Dirty *dirty,
+          SDL_Rect rect)
+{
+    SDL_Rect r;
+
+    if (!SDL_IntersectRect(&rect, &dirty->bounds, &r)) return;
+
+    for (uint32_t i = 0; i < dirty->count; ++i) {
+        if (!near(r, dirty->rects[i])) continue;
+        // the bigger rectangle may now touch ones that were already checked
+        SDL_UnionRect(&r, &dirty->rects[i], &r);
+        removeRect(dirty, i);
+        i = -1;
+    }
+
+    while (dirty->count == DIRTY_MAX) {
+        uint32_t best = 0;
+        int growth = 0;
+
+        for (uint32_t i = 0; i < dirty->count; ++i) {
+            SDL_Rect u;
+            SDL_UnionRect(&r, &dirty->rects[i], &u);
+            if (i == 0 || area(u) - area(dirty->rects[i]) < growth) {
+                best = i;
+                growth = area(u) - area(dirty->rects[i]);
+            }
+        }
+
+        SDL_UnionRect(&r, &dirty->rects[best], &r);
+        removeRect(dirty, best);
+    }
+
+    dirty->rects[dirty->count++] = r;
+}
+
+int
+Dirty_Area(const Dirty *dirty)
+// pixels that will be redrawn, the rectangles never overlap by much
+{
+    int total = 0;
+
+    for (uint32_t i = 0; i < dirty->count; ++i) total += area(dirty->rects[i]);
+    return total;
+}
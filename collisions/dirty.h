@@ -0,0 +1,27 @@
+#ifndef DIRTY_H
+#define DIRTY_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// The parts of the screen that changed this frame. Rectangles that touch are
+// merged as they are added, and once the list is full a new rectangle is merged
+// into whichever one grows the least, so there are never more than DIRTY_MAX
+// to redraw and upload.
+
+#define DIRTY_MAX 16
+// rectangles closer than this are merged, a few more pixels are cheaper than
+// another texture update
+#define DIRTY_SLACK 8
+
+typedef struct _Dirty {
+    SDL_Rect bounds; // everything is clipped to this
+    SDL_Rect rects[DIRTY_MAX];
+    uint32_t count;
+} Dirty;
+
+void Dirty_Add(Dirty *dirty, SDL_Rect rect);
+int Dirty_Area(const Dirty *dirty);
+
+#endif
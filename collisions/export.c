@@ -0,0 +1,163 @@
+#include <string.h>
+
+#include "export.h"
+
+static bool
+validPattern(const char *pattern)
+// Exactly one %d or %u, zero padding and a width allowed, %% for a plain %.
+// It goes to snprintf as the format, anything else there is undefined.
+{
+    uint32_t conversions = 0;
+
+    for (const char *p = pattern; *p; ++p) {
+        if (*p != '%') continue;
+        if (*++p == '%') continue;
+
+        if (*p == '0') p++;
+        while (*p >= '0' && *p <= '9') p++;
+        if (*p != 'd' && *p != 'u') return false;
+        conversions++;
+    }
+
+    return conversions == 1;
+}
+
+static void
+freeFrames(Export *export)
+{
+    for (int i = 0; i < 2; ++i) {
+        if (export->renderers[i]) SDL_DestroyRenderer(export->renderers[i]);
+        SDL_FreeSurface(export->frames[i]);
+        export->renderers[i] = NULL;
+        export->frames[i] = NULL;
+    }
+}
+
+static bool
+writeFrame(Export *export,
+           SDL_Surface *frame)
+{
+    if (export->out) {
+        // RGBA32 has no padding at 4 bytes a pixel so the whole surface is
+        // one write
+        size_t size = (size_t)frame->pitch * frame->h;
+        return fwrite(frame->pixels, 1, size, export->out) == size;
+    }
+
+    char path[4096];
+    snprintf(path, sizeof(path), export->pattern, export->written);
+    return SDL_SaveBMP(frame, path) == 0;
+}
+
+static void *
+exportThread(void *data)
+{
+    Export *export = data;
+    uint8_t i = 0;
+
+    pthread_mutex_lock(&export->lock);
+    for (;;) {
+        while (!export->full[i] && !export->done)
+            pthread_cond_wait(&export->cond, &export->lock);
+        if (!export->full[i]) break;
+
+        // the game is drawing into the other frame, this one is ours
+        pthread_mutex_unlock(&export->lock);
+        bool ok = writeFrame(export, export->frames[i]);
+        pthread_mutex_lock(&export->lock);
+
+        if (!ok) export->failed = true;
+        export->written++;
+        export->full[i] = false;
+        pthread_cond_broadcast(&export->cond);
+        i ^= 1;
+    }
+    pthread_mutex_unlock(&export->lock);
+
+    return NULL;
+}
+
+bool
+Export_Start(Export *export,
+             const char *path,
+             int w,
+             int h)
+// path is "-" for stdout
+{
+    memset(export, 0, sizeof(Export));
+
+    if (strchr(path, '%')) {
+        if (!validPattern(path)) {
+            fprintf(stderr, "export: %s needs exactly one %%d or %%u\n", path);
+            return false;
+        }
+        export->pattern = path;
+    } else if (strcmp(path, "-") == 0) {
+        export->out = stdout;
+    } else {
+        export->out = fopen(path, "wb");
+        if (!export->out) return false;
+        export->close_out = true;
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        // bytes in memory are r, g, b, a whatever the endianness, which is
+        // what ffmpeg calls rgba
+        export->frames[i] =
+            SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32);
+        if (export->frames[i])
+            export->renderers[i] =
+                SDL_CreateSoftwareRenderer(export->frames[i]);
+        if (!export->renderers[i]) {
+            freeFrames(export);
+            if (export->close_out) fclose(export->out);
+            return false;
+        }
+    }
+
+    pthread_mutex_init(&export->lock, NULL);
+    pthread_cond_init(&export->cond, NULL);
+    if (pthread_create(&export->thread, NULL, exportThread, export) != 0) {
+        pthread_mutex_destroy(&export->lock);
+        pthread_cond_destroy(&export->cond);
+        freeFrames(export);
+        if (export->close_out) fclose(export->out);
+        return false;
+    }
+
+    return true;
+}
+
+void
+Export_Submit(Export *export)
+// Hands the frame that was just drawn to the writer and switches to the other
+// one. Only waits if the writer is still busy with the other frame.
+{
+    pthread_mutex_lock(&export->lock);
+    export->full[export->current] = true;
+    pthread_cond_broadcast(&export->cond);
+    export->current ^= 1;
+    while (export->full[export->current])
+        pthread_cond_wait(&export->cond, &export->lock);
+    pthread_mutex_unlock(&export->lock);
+}
+
+bool
+Export_Stop(Export *export)
+// Writes out what is left. Returns false if any frame failed to write.
+{
+    pthread_mutex_lock(&export->lock);
+    export->done = true;
+    pthread_cond_broadcast(&export->cond);
+    pthread_mutex_unlock(&export->lock);
+    pthread_join(export->thread, NULL);
+
+    pthread_mutex_destroy(&export->lock);
+    pthread_cond_destroy(&export->cond);
+
+    if (export->out) fflush(export->out);
+    if (export->close_out) fclose(export->out);
+
+    freeFrames(export);
+    return !export->failed;
+}
@@ -0,0 +1,42 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+// Writes frames out instead of showing them. There are two backbuffers, each
+// with its own software renderer: the game draws into one while a thread
+// writes the other, straight from the surface pixels. Raw RGBA goes to a file
+// or stdout (pipe it to ffmpeg), a path with a % in it is used as a printf
+// pattern for numbered BMP images. It has to have exactly one %d or %u
+// (frame%05d.bmp), anything else is refused.
+//
+//   ./balls export 600 |
+//       ffmpeg -f rawvideo -pix_fmt rgba -s 800x800 -r 60 -i - balls.mp4
+
+typedef struct _Export {
+    SDL_Surface *frames[2];
+    SDL_Renderer *renderers[2];
+    uint8_t current; // the one the game draws into
+    bool full[2]; // waiting to be written
+    bool done;
+    bool failed;
+
+    FILE *out; // raw frames, NULL when writing images
+    bool close_out;
+    const char *pattern; // printf pattern for images
+    uint32_t written;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} Export;
+
+bool Export_Start(Export *export, const char *path, int w, int h);
+void Export_Submit(Export *export);
+bool Export_Stop(Export *export);
+
+#endif
@@ -0,0 +1,319 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "obstacles.h"
+
+size_t
+Obstacles_Size(uint32_t capacity)
+// arena space needed by Obstacles_Init, with room for alignment
+{
+    return capacity * sizeof(Obstacle) + (2 * capacity + 1) * sizeof(Node) +
+           256;
+}
+
+bool
+Obstacles_Init(Obstacles *obstacles,
+               Arena *arena,
+               uint32_t capacity)
+{
+    *obstacles = (Obstacles) {.capacity = capacity};
+    obstacles->items = Arena_Alloc(arena, capacity * sizeof(Obstacle));
+    // a tree with at least one obstacle per leaf has fewer than 2n nodes
+    obstacles->nodes = Arena_Alloc(arena, (2 * capacity + 1) * sizeof(Node));
+    return obstacles->items && obstacles->nodes;
+}
+
+bool
+Obstacles_AddRect(Obstacles *obstacles,
+                  float x,
+                  float y,
+                  float w,
+                  float h)
+{
+    if (obstacles->count == obstacles->capacity) return false;
+    obstacles->items[obstacles->count++] = (Obstacle) {
+        .kind = OBSTACLE_RECT,
+        .x0 = x, .y0 = y,
+        .x1 = x + w, .y1 = y + h
+    };
+    return true;
+}
+
+bool
+Obstacles_AddSegment(Obstacles *obstacles,
+                     float x0,
+                     float y0,
+                     float x1,
+                     float y1)
+{
+    if (obstacles->count == obstacles->capacity) return false;
+    obstacles->items[obstacles->count++] = (Obstacle) {
+        .kind = OBSTACLE_SEGMENT,
+        .x0 = x0, .y0 = y0,
+        .x1 = x1, .y1 = y1
+    };
+    return true;
+}
+
+static bool
+parseLine(const char *line,
+          Obstacle *obstacle)
+{
+    float a, b, c, d;
+
+    line += strspn(line, " \t");
+    if (sscanf(line, "rect %f %f %f %f", &a, &b, &c, &d) == 4) {
+        // a negative width or height grows the rect left or up
+        *obstacle = (Obstacle) {OBSTACLE_RECT, fminf(a, a + c), fminf(b, b + d),
+                                fmaxf(a, a + c), fmaxf(b, b + d)};
+        return true;
+    }
+    if (sscanf(line, "segment %f %f %f %f", &a, &b, &c, &d) == 4) {
+        *obstacle = (Obstacle) {OBSTACLE_SEGMENT, a, b, c, d};
+        return true;
+    }
+    return false;
+}
+
+uint32_t
+Obstacles_Count(const char *path)
+// number of obstacles in a level file, to size the arena before loading it
+{
+    FILE *file = fopen(path, "r");
+    char line[256];
+    Obstacle obstacle;
+    uint32_t count = 0;
+
+    if (!file) return 0;
+    while (fgets(line, sizeof(line), file))
+        if (parseLine(line, &obstacle)) count++;
+    fclose(file);
+    return count;
+}
+
+bool
+Obstacles_Load(Obstacles *obstacles,
+               const char *path)
+// Adds the obstacles in a level file. Call Obstacles_Build afterwards.
+{
+    FILE *file = fopen(path, "r");
+    char line[256];
+    Obstacle obstacle;
+
+    if (!file) return false;
+    while (fgets(line, sizeof(line), file)) {
+        if (!parseLine(line, &obstacle)) continue;
+        if (obstacles->count == obstacles->capacity) break;
+        obstacles->items[obstacles->count++] = obstacle;
+    }
+    fclose(file);
+    return true;
+}
+
+static int
+compareX(const void *a,
+         const void *b)
+{
+    const Obstacle *o1 = a;
+    const Obstacle *o2 = b;
+    float c1 = o1->x0 + o1->x1;
+    float c2 = o2->x0 + o2->x1;
+    return (c1 > c2) - (c1 < c2);
+}
+
+static int
+compareY(const void *a,
+         const void *b)
+{
+    const Obstacle *o1 = a;
+    const Obstacle *o2 = b;
+    float c1 = o1->y0 + o1->y1;
+    float c2 = o2->y0 + o2->y1;
+    return (c1 > c2) - (c1 < c2);
+}
+
+static void
+build(Obstacles *obstacles,
+      uint32_t index,
+      uint32_t first,
+      uint32_t count)
+// Top down: split the obstacles in half along the longer side of the box
+// their centres fit in.
+{
+    Node *node = &obstacles->nodes[index];
+    float cmin_x = INFINITY, cmin_y = INFINITY;
+    float cmax_x = -INFINITY, cmax_y = -INFINITY;
+
+    node->min_x = node->min_y = INFINITY;
+    node->max_x = node->max_y = -INFINITY;
+
+    for (uint32_t i = first; i < first + count; ++i) {
+        const Obstacle *o = &obstacles->items[i];
+        float cx = (o->x0 + o->x1) * 0.5f;
+        float cy = (o->y0 + o->y1) * 0.5f;
+
+        // segments can go either way so use min and max
+        node->min_x = fminf(node->min_x, fminf(o->x0, o->x1));
+        node->min_y = fminf(node->min_y, fminf(o->y0, o->y1));
+        node->max_x = fmaxf(node->max_x, fmaxf(o->x0, o->x1));
+        node->max_y = fmaxf(node->max_y, fmaxf(o->y0, o->y1));
+        cmin_x = fminf(cmin_x, cx);
+        cmin_y = fminf(cmin_y, cy);
+        cmax_x = fmaxf(cmax_x, cx);
+        cmax_y = fmaxf(cmax_y, cy);
+    }
+
+    node->first = first;
+    node->count = count;
+    if (count <= OBSTACLES_LEAF_SIZE) return;
+
+    qsort(&obstacles->items[first], count, sizeof(Obstacle),
+          (cmax_x - cmin_x >= cmax_y - cmin_y) ? compareX : compareY);
+
+    uint32_t half = count / 2;
+    node->count = 0;
+    node->left = obstacles->node_count;
+    obstacles->node_count += 2;
+    build(obstacles, node->left, first, half);
+    build(obstacles, node->left + 1, first + half, count - half);
+}
+
+void
+Obstacles_Build(Obstacles *obstacles)
+// Builds the tree. Reorders the obstacles.
+{
+    obstacles->node_count = 0;
+    if (obstacles->count == 0) return;
+    obstacles->node_count = 1;
+    build(obstacles, 0, 0, obstacles->count);
+}
+
+static float
+clamp(float v,
+      float min,
+      float max)
+{
+    if (v < min) return min;
+    if (v > max) return max;
+    return v;
+}
+
+static uint32_t
+collideOne(const Obstacle *o,
+           float *px,
+           float *py,
+           float *vx,
+           float *vy,
+           float radius,
+           float restitution)
+{
+    float closestX, closestY;
+
+    if (o->kind == OBSTACLE_RECT) {
+        closestX = clamp(*px, o->x0, o->x1);
+        closestY = clamp(*py, o->y0, o->y1);
+    } else {
+        float sx = o->x1 - o->x0;
+        float sy = o->y1 - o->y0;
+        float length2 = sx * sx + sy * sy;
+        float t = length2 > 0 ?
+                  clamp(((*px - o->x0) * sx + (*py - o->y0) * sy) / length2,
+                        0, 1) : 0;
+        closestX = o->x0 + sx * t;
+        closestY = o->y0 + sy * t;
+    }
+
+    // this gets the distance form the center of the circle to the closest
+    // point. It could be negative or positive. Because we are squaring them
+    // it doesn't matter.
+    float dx = *px - closestX;
+    float dy = *py - closestY;
+    float distance2 = dx * dx + dy * dy;
+
+    if (distance2 > radius * radius) return 0;
+
+    float nx, ny, depth;
+
+    if (distance2 > 0) {
+        float distance = sqrtf(distance2);
+        nx = dx / distance;
+        ny = dy / distance;
+        depth = radius - distance;
+    } else if (o->kind == OBSTACLE_RECT) {
+        // centre is inside the rectangle, leave by the nearest side
+        float left = *px - o->x0;
+        float right = o->x1 - *px;
+        float top = *py - o->y0;
+        float bottom = o->y1 - *py;
+        float least = fminf(fminf(left, right), fminf(top, bottom));
+
+        nx = (least == left) ? -1 : (least == right) ? 1 : 0;
+        ny = (nx != 0) ? 0 : (least == top) ? -1 : 1;
+        depth = least + radius;
+    } else {
+        // centre right on the segment, push out along its normal
+        float sx = o->x1 - o->x0;
+        float sy = o->y1 - o->y0;
+        float length = sqrtf(sx * sx + sy * sy);
+
+        if (length == 0) return 0;
+        nx = -sy / length;
+        ny = sx / length;
+        depth = radius;
+    }
+
+    *px += nx * depth;
+    *py += ny * depth;
+
+    // only bounce if it is heading into the obstacle
+    float vn = *vx * nx + *vy * ny;
+    if (vn < 0) {
+        *vx -= (1.0f + restitution) * vn * nx;
+        *vy -= (1.0f + restitution) * vn * ny;
+    }
+
+    return 1;
+}
+
+uint32_t
+Obstacles_Collide(const Obstacles *obstacles,
+                  float *px,
+                  float *py,
+                  float *vx,
+                  float *vy,
+                  float radius,
+                  float restitution)
+// Pushes a ball out of every obstacle it overlaps and bounces it off. Returns
+// the number of obstacles it touched.
+{
+    uint32_t stack[OBSTACLES_STACK_SIZE];
+    uint32_t top = 0;
+    uint32_t touched = 0;
+
+    if (obstacles->node_count == 0) return 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const Node *node = &obstacles->nodes[stack[--top]];
+
+        if (*px + radius < node->min_x || *px - radius > node->max_x ||
+            *py + radius < node->min_y || *py - radius > node->max_y)
+            continue;
+
+        if (node->count > 0) {
+            for (uint32_t i = node->first; i < node->first + node->count; ++i)
+                touched += collideOne(&obstacles->items[i], px, py, vx, vy,
+                                      radius, restitution);
+            continue;
+        }
+
+        // the tree is balanced so the depth is about log2(n / leaf size)
+        if (top + 2 > OBSTACLES_STACK_SIZE) continue;
+        stack[top++] = node->left;
+        stack[top++] = node->left + 1;
+    }
+
+    return touched;
+}
@@ -0,0 +1,59 @@
+#ifndef OBSTACLES_H
+#define OBSTACLES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+// Rectangles and line segments that never move. They are put in a bounding
+// volume tree once, after that a ball only has to look at the obstacles whose
+// boxes its own box overlaps, O(log n) instead of checking all of them.
+//
+// A level file has one obstacle per line, # starts a comment:
+//
+//   rect x y w h
+//   segment x0 y0 x1 y1
+
+// obstacles per leaf of the tree
+#define OBSTACLES_LEAF_SIZE 4
+#define OBSTACLES_STACK_SIZE 64
+
+enum {OBSTACLE_RECT, OBSTACLE_SEGMENT};
+
+typedef struct _Obstacle {
+    uint8_t kind;
+    // rect: top left and bottom right corners, segment: the end points
+    float x0, y0, x1, y1;
+} Obstacle;
+
+typedef struct _Node {
+    float min_x, min_y, max_x, max_y;
+    uint32_t left; // right child is left + 1
+    uint32_t first; // first obstacle of a leaf
+    uint32_t count; // obstacles in a leaf, 0 for inner nodes
+} Node;
+
+typedef struct _Obstacles {
+    Obstacle *items;
+    uint32_t count;
+    uint32_t capacity;
+    Node *nodes;
+    uint32_t node_count;
+} Obstacles;
+
+size_t Obstacles_Size(uint32_t capacity);
+bool Obstacles_Init(Obstacles *obstacles, Arena *arena, uint32_t capacity);
+bool Obstacles_AddRect(Obstacles *obstacles, float x, float y, float w,
+                       float h);
+bool Obstacles_AddSegment(Obstacles *obstacles, float x0, float y0, float x1,
+                          float y1);
+uint32_t Obstacles_Count(const char *path);
+bool Obstacles_Load(Obstacles *obstacles, const char *path);
+void Obstacles_Build(Obstacles *obstacles);
+uint32_t Obstacles_Collide(const Obstacles *obstacles, float *px, float *py,
+                           float *vx, float *vy, float radius,
+                           float restitution);
+
+#endif
@@ -0,0 +1,248 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "publish.h"
+
+static PublishSlot *
+slotAt(const Publish *publish,
+       uint64_t frame)
+{
+    // slots start on their own cache line after the header
+    size_t first = (sizeof(PublishHeader) + 63) & ~(size_t)63;
+
+    return (PublishSlot *)((uint8_t *)publish->header + first +
+                           (frame % PUBLISH_SLOTS) *
+                           publish->header->slot_size);
+}
+
+static size_t
+segmentSize(uint64_t slot_size)
+{
+    return ((sizeof(PublishHeader) + 63) & ~(size_t)63) +
+           PUBLISH_SLOTS * slot_size;
+}
+
+bool
+Publish_Start(Publish *publish,
+              const char *name,
+              uint32_t capacity,
+              float width,
+              float height)
+// Makes the segment, or takes over one left behind by a run that did not get
+// to Publish_Close.
+{
+    uint64_t slot_size = (sizeof(PublishSlot) +
+                          capacity * sizeof(PublishedBall) + 63) & ~63ULL;
+
+    *publish = (Publish) {
+        .name = name,
+        .writer = true,
+        .size = segmentSize(slot_size),
+    };
+
+    struct stat st;
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror("shm_open");
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    // One of another size is not reused, a viewer that has it mapped would
+    // read past its end. It keeps the old one, which just stops changing.
+    if (st.st_size != 0 && (size_t)st.st_size != publish->size) {
+        close(fd);
+        shm_unlink(name);
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) {
+            perror("shm_open");
+            return false;
+        }
+        st.st_size = 0;
+    }
+
+    if (ftruncate(fd, publish->size) != 0) {
+        perror("ftruncate");
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    void *map = mmap(NULL, publish->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        shm_unlink(name);
+        return false;
+    }
+
+    publish->header = map;
+
+    // A viewer may still be reading the one left behind. Its slots are made
+    // odd before they are wiped, so a copy in progress is thrown away, and
+    // they start again past that, so nothing is taken for a frame it read.
+    uint64_t sequences[PUBLISH_SLOTS] = {0};
+    if (st.st_size != 0 && publish->header->magic == PUBLISH_MAGIC) {
+        for (uint32_t i = 0; i < PUBLISH_SLOTS; ++i) {
+            PublishSlot *slot = slotAt(publish, i);
+            uint64_t sequence = atomic_load(&slot->sequence) | 1;
+
+            atomic_store(&slot->sequence, sequence);
+            sequences[i] = sequence + 1;
+        }
+        atomic_thread_fence(memory_order_release);
+    }
+
+    // a reader checks the magic, so it goes in last
+    memset(map, 0, publish->size);
+    publish->header->capacity = capacity;
+    publish->header->slot_size = slot_size;
+    publish->header->width = width;
+    publish->header->height = height;
+    for (uint32_t i = 0; i < PUBLISH_SLOTS; ++i)
+        atomic_store(&slotAt(publish, i)->sequence, sequences[i]);
+    atomic_init(&publish->header->latest, 0);
+    atomic_thread_fence(memory_order_release);
+    publish->header->magic = PUBLISH_MAGIC;
+
+    return true;
+}
+
+void
+Publish_Frame(Publish *publish,
+              const World *world,
+              const uint32_t *palette)
+// Copies the balls into the next slot. palette turns a ball's colour into
+// RGBA for readers that do not know the game's colours.
+{
+    PublishHeader *header = publish->header;
+
+    if (!header) return;
+
+    uint64_t frame = ++publish->frame;
+    PublishSlot *slot = slotAt(publish, frame);
+    uint64_t sequence = atomic_load_explicit(&slot->sequence,
+                                             memory_order_relaxed);
+    uint32_t count = world->ball_count;
+
+    if (count > header->capacity) count = header->capacity;
+
+    // odd, anyone copying this slot now will throw it away
+    atomic_store_explicit(&slot->sequence, sequence + 1,
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->frame = frame;
+    slot->ball_count = count;
+    for (uint32_t i = 0; i < count; ++i) {
+        const Ball *b = &world->balls[i];
+        slot->balls[i] = (PublishedBall) {
+            .x = b->px,
+            .y = b->py,
+            .radius = Ball_Radius(b),
+            .color = palette[Ball_Color(b)],
+            .id = world->ball_ids[i],
+        };
+    }
+
+    atomic_store_explicit(&slot->sequence, sequence + 2,
+                          memory_order_release);
+    atomic_store_explicit(&header->latest, frame, memory_order_release);
+}
+
+bool
+Publish_Open(Publish *publish,
+             const char *name)
+// Maps a segment read only. Fails if nobody has started one with this name.
+{
+    struct stat st;
+
+    *publish = (Publish) {.name = name};
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return false;
+
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(PublishHeader)) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    PublishHeader *header = map;
+    publish->header = header;
+    publish->size = st.st_size;
+
+    if (header->magic != PUBLISH_MAGIC ||
+        segmentSize(header->slot_size) > publish->size) {
+        Publish_Close(publish);
+        return false;
+    }
+    atomic_thread_fence(memory_order_acquire);
+
+    publish->balls = malloc(header->capacity * sizeof(PublishedBall));
+    if (!publish->balls) {
+        Publish_Close(publish);
+        return false;
+    }
+
+    return true;
+}
+
+bool
+Publish_Read(Publish *publish)
+// Copies the newest complete frame into balls. False if there is nothing newer
+// than the last one read, or the writer kept getting in the way.
+{
+    const PublishHeader *header = publish->header;
+
+    for (uint32_t try = 0; try < PUBLISH_TRIES; ++try) {
+        uint64_t frame = atomic_load_explicit(&header->latest,
+                                              memory_order_acquire);
+
+        if (frame == 0 || frame == publish->frame) return false;
+
+        PublishSlot *slot = slotAt(publish, frame);
+        uint64_t before = atomic_load_explicit(&slot->sequence,
+                                               memory_order_acquire);
+
+        if (before & 1) continue;
+
+        uint32_t count = slot->ball_count;
+        if (count > header->capacity) continue;
+        memcpy(publish->balls, slot->balls, count * sizeof(PublishedBall));
+        uint64_t copied = slot->frame;
+
+        // the copy has to be done before the sequence is looked at again
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t after = atomic_load_explicit(&slot->sequence,
+                                              memory_order_relaxed);
+
+        if (before != after || copied != frame) continue;
+
+        publish->ball_count = count;
+        publish->frame = frame;
+        return true;
+    }
+
+    return false;
+}
+
+void
+Publish_Close(Publish *publish)
+// The writer removes the name too, readers that have it mapped keep their
+// mapping.
+{
+    if (publish->header) munmap(publish->header, publish->size);
+    if (publish->writer) shm_unlink(publish->name);
+    free(publish->balls);
+    *publish = (Publish) {0};
+}
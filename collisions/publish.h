@@ -0,0 +1,67 @@
+#ifndef PUBLISH_H
+#define PUBLISH_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "world.h"
+
+// Puts every step's balls in POSIX shared memory, so other processes (the
+// viewer, analysis tools) can watch a running world without slowing it down.
+//
+// The segment has a header and PUBLISH_SLOTS slots, written round robin. Each
+// slot has a sequence number, a seqlock: odd while the writer is in it, bumped
+// again when it is done. A reader copies the newest slot and checks the
+// sequence did not change while it copied, if it did the copy is thrown away
+// and it tries again. The writer never waits for anybody, a slow reader just
+// sees frames go missing.
+
+#define PUBLISH_NAME "/balls"
+#define PUBLISH_MAGIC 0x6c6c6162 // "ball"
+#define PUBLISH_SLOTS 4
+#define PUBLISH_TRIES 8 // reads before giving up on a frame
+
+typedef struct _PublishedBall {
+    float x, y, radius;
+    uint32_t color; // 0xRRGGBBAA
+    uint32_t id;
+} PublishedBall;
+
+typedef struct _PublishSlot {
+    atomic_uint_least64_t sequence; // odd while being written
+    uint64_t frame;
+    uint32_t ball_count;
+    PublishedBall balls[];
+} PublishSlot;
+
+typedef struct _PublishHeader {
+    uint32_t magic;
+    uint32_t capacity; // balls per slot
+    uint64_t slot_size; // bytes, balls included
+    float width, height;
+    atomic_uint_least64_t latest; // newest complete frame, 0 for none yet
+} PublishHeader;
+
+typedef struct _Publish {
+    PublishHeader *header; // NULL when not started
+    size_t size;
+    const char *name;
+    bool writer;
+    uint64_t frame; // last one written or read
+
+    // what the reader copied out
+    PublishedBall *balls;
+    uint32_t ball_count;
+} Publish;
+
+bool Publish_Start(Publish *publish, const char *name, uint32_t capacity,
+                   float width, float height);
+void Publish_Frame(Publish *publish, const World *world,
+                   const uint32_t *palette);
+bool Publish_Open(Publish *publish, const char *name);
+bool Publish_Read(Publish *publish);
+void Publish_Close(Publish *publish);
+
+#endif
@@ -0,0 +1,403 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "raster.h"
+
+typedef struct _Clip {
+    int x0, y0, x1, y1; // x1 and y1 are one past the end
+} Clip;
+
+bool
+Raster_Init(Raster *raster,
+            SDL_Surface *target,
+            uint32_t shapes,
+            Pool *pool)
+// target has to be 32 bits per pixel. pool can be NULL to draw on the calling
+// thread only.
+{
+    *raster = (Raster) {
+        .target = target,
+        .pool = pool,
+        .tiles_x = (target->w + RASTER_TILE - 1) / RASTER_TILE,
+        .tiles_y = (target->h + RASTER_TILE - 1) / RASTER_TILE,
+        .shape_capacity = shapes,
+    };
+
+    uint32_t tiles = raster->tiles_x * raster->tiles_y;
+
+    // room for every shape in every tile, so binning never has to grow it
+    // while drawing
+    if ((uint64_t)shapes * tiles > UINT32_MAX) return false;
+    raster->bin_capacity = shapes * tiles;
+
+    raster->shapes = malloc(shapes * sizeof(Shape));
+    raster->start = malloc((tiles + 1) * sizeof(uint32_t));
+    raster->bins = malloc(raster->bin_capacity * sizeof(uint32_t));
+    raster->dirty = malloc(tiles * sizeof(bool));
+    raster->tiles = malloc(tiles * sizeof(uint32_t));
+
+    if (!raster->shapes || !raster->start || !raster->bins ||
+        !raster->dirty || !raster->tiles) {
+        Raster_Free(raster);
+        return false;
+    }
+
+    return true;
+}
+
+void
+Raster_Free(Raster *raster)
+{
+    free(raster->shapes);
+    free(raster->start);
+    free(raster->bins);
+    free(raster->dirty);
+    free(raster->tiles);
+    *raster = (Raster) {0};
+}
+
+void
+Raster_Clear(Raster *raster)
+{
+    raster->shape_count = 0;
+}
+
+static void
+addShape(Raster *raster,
+         Shape shape)
+{
+    if (raster->shape_count == raster->shape_capacity) return;
+    raster->shapes[raster->shape_count++] = shape;
+}
+
+void
+Raster_Rect(Raster *raster,
+            float x,
+            float y,
+            float w,
+            float h,
+            uint32_t color)
+{
+    addShape(raster, (Shape) {
+        .kind = RASTER_RECT,
+        .a = x, .b = y, .c = w, .d = h,
+        .color = color,
+        .box = {.x = x, .y = y, .w = w, .h = h}
+    });
+}
+
+void
+Raster_Segment(Raster *raster,
+               float x0,
+               float y0,
+               float x1,
+               float y1,
+               uint32_t color)
+{
+    addShape(raster, (Shape) {
+        .kind = RASTER_SEGMENT,
+        .a = x0, .b = y0, .c = x1, .d = y1,
+        .color = color,
+        .box = {
+            .x = fminf(x0, x1) - 1,
+            .y = fminf(y0, y1) - 1,
+            .w = fabsf(x1 - x0) + 3,
+            .h = fabsf(y1 - y0) + 3
+        }
+    });
+}
+
+void
+Raster_Ring(Raster *raster,
+            float x,
+            float y,
+            float radius,
+            float width,
+            uint32_t color)
+// width pixels wide, on the outside of radius
+{
+    float outer = radius + width;
+
+    addShape(raster, (Shape) {
+        .kind = RASTER_RING,
+        .a = x, .b = y, .c = radius, .d = width,
+        .color = color,
+        .box = {
+            .x = x - outer - 1,
+            .y = y - outer - 1,
+            .w = outer * 2 + 3,
+            .h = outer * 2 + 3
+        }
+    });
+}
+
+void
+Raster_Disc(Raster *raster,
+            float x,
+            float y,
+            float radius,
+            uint32_t color)
+{
+    addShape(raster, (Shape) {
+        .kind = RASTER_DISC,
+        .a = x, .b = y, .c = radius, .d = 0,
+        .color = color,
+        .box = {
+            .x = x - radius - 1,
+            .y = y - radius - 1,
+            .w = radius * 2 + 3,
+            .h = radius * 2 + 3
+        }
+    });
+}
+
+static uint32_t *
+row(const Raster *raster,
+    int y)
+{
+    return (uint32_t *)((uint8_t *)raster->target->pixels +
+                        y * raster->target->pitch);
+}
+
+static void
+span(const Raster *raster,
+     const Clip *clip,
+     int y,
+     int x0,
+     int x1,
+     uint32_t color)
+{
+    if (x0 < clip->x0) x0 = clip->x0;
+    if (x1 > clip->x1) x1 = clip->x1;
+
+    uint32_t *pixels = row(raster, y);
+    for (int x = x0; x < x1; ++x) pixels[x] = color;
+}
+
+static void
+drawRect(const Raster *raster,
+         const Clip *clip,
+         const Shape *s)
+{
+    int y0 = s->box.y;
+    int y1 = s->box.y + s->box.h;
+
+    if (y0 < clip->y0) y0 = clip->y0;
+    if (y1 > clip->y1) y1 = clip->y1;
+    for (int y = y0; y < y1; ++y)
+        span(raster, clip, y, s->box.x, s->box.x + s->box.w, s->color);
+}
+
+static void
+drawSegment(const Raster *raster,
+            const Clip *clip,
+            const Shape *s)
+// One pixel per step along the longer axis. Only the steps that land inside
+// the clip along that axis are walked.
+{
+    int x0 = s->a, y0 = s->b, x1 = s->c, y1 = s->d;
+    int dx = x1 - x0, dy = y1 - y0;
+    bool wide = abs(dx) >= abs(dy);
+    int steps = wide ? abs(dx) : abs(dy);
+    int from = 0, to = steps;
+
+    if (steps == 0) {
+        if (x0 >= clip->x0 && x0 < clip->x1 && y0 >= clip->y0 &&
+            y0 < clip->y1)
+            row(raster, y0)[x0] = s->color;
+        return;
+    }
+
+    // step range inside the clip along the longer axis
+    int start = wide ? x0 : y0;
+    int sign = (wide ? dx : dy) > 0 ? 1 : -1;
+    int lo = wide ? clip->x0 : clip->y0;
+    int hi = (wide ? clip->x1 : clip->y1) - 1;
+    int a = (lo - start) * sign;
+    int b = (hi - start) * sign;
+
+    if (a > b) {
+        int t = a;
+        a = b;
+        b = t;
+    }
+    if (a > from) from = a;
+    if (b < to) to = b;
+
+    for (int i = from; i <= to; ++i) {
+        int x = wide ? x0 + i * sign : x0 + (int)lrintf((float)dx * i / steps);
+        int y = wide ? y0 + (int)lrintf((float)dy * i / steps) : y0 + i * sign;
+
+        if (x < clip->x0 || x >= clip->x1 || y < clip->y0 || y >= clip->y1)
+            continue;
+        row(raster, y)[x] = s->color;
+    }
+}
+
+static void
+drawRound(const Raster *raster,
+          const Clip *clip,
+          const Shape *s)
+// Rings and discs, a row at a time. A pixel is in if its centre is.
+{
+    float cx = s->a, cy = s->b;
+    float inner = s->c;
+    float outer = s->kind == RASTER_RING ? s->c + s->d : s->c;
+    int y0 = floorf(cy - outer);
+    int y1 = ceilf(cy + outer) + 1;
+
+    if (y0 < clip->y0) y0 = clip->y0;
+    if (y1 > clip->y1) y1 = clip->y1;
+
+    for (int y = y0; y < y1; ++y) {
+        float fy = y + 0.5f - cy;
+        float o2 = outer * outer - fy * fy;
+
+        if (o2 < 0) continue;
+
+        float ho = sqrtf(o2);
+        int xa = ceilf(cx - ho - 0.5f);
+        int xb = floorf(cx + ho - 0.5f) + 1;
+        float i2 = inner * inner - fy * fy;
+
+        if (s->kind == RASTER_DISC || i2 <= 0) {
+            span(raster, clip, y, xa, xb, s->color);
+            continue;
+        }
+
+        float hi = sqrtf(i2);
+        span(raster, clip, y, xa, ceilf(cx - hi - 0.5f), s->color);
+        span(raster, clip, y, floorf(cx + hi - 0.5f) + 1, xb, s->color);
+    }
+}
+
+static void
+drawTile(void *data,
+         uint32_t task,
+         uint32_t worker)
+{
+    (void)worker;
+    Raster *raster = data;
+    uint32_t tile = raster->tiles[task];
+    int tx = tile % raster->tiles_x;
+    int ty = tile / raster->tiles_x;
+    Clip clip = {
+        .x0 = tx * RASTER_TILE,
+        .y0 = ty * RASTER_TILE,
+        .x1 = tx * RASTER_TILE + RASTER_TILE,
+        .y1 = ty * RASTER_TILE + RASTER_TILE,
+    };
+
+    if (clip.x1 > raster->target->w) clip.x1 = raster->target->w;
+    if (clip.y1 > raster->target->h) clip.y1 = raster->target->h;
+
+    for (int y = clip.y0; y < clip.y1; ++y)
+        span(raster, &clip, y, clip.x0, clip.x1, raster->background);
+
+    for (uint32_t i = raster->start[tile]; i < raster->start[tile + 1]; ++i) {
+        const Shape *s = &raster->shapes[raster->bins[i]];
+
+        switch (s->kind) {
+            case RASTER_RECT: drawRect(raster, &clip, s); break;
+            case RASTER_SEGMENT: drawSegment(raster, &clip, s); break;
+            default: drawRound(raster, &clip, s); break;
+        }
+    }
+}
+
+static bool
+tileRange(const Raster *raster,
+          SDL_Rect box,
+          int *x0,
+          int *y0,
+          int *x1,
+          int *y1)
+// tiles a box overlaps, false if none
+{
+    int w = raster->target->w;
+    int h = raster->target->h;
+
+    if (box.w <= 0 || box.h <= 0 || box.x >= w || box.y >= h ||
+        box.x + box.w <= 0 || box.y + box.h <= 0)
+        return false;
+
+    *x0 = (box.x < 0 ? 0 : box.x) / RASTER_TILE;
+    *y0 = (box.y < 0 ? 0 : box.y) / RASTER_TILE;
+    *x1 = ((box.x + box.w > w ? w : box.x + box.w) - 1) / RASTER_TILE;
+    *y1 = ((box.y + box.h > h ? h : box.y + box.h) - 1) / RASTER_TILE;
+    return true;
+}
+
+static void
+bin(Raster *raster)
+// Counting sort of the shapes into the dirty tiles, two passes so that the
+// bins are one flat array.
+{
+    uint32_t tiles = raster->tiles_x * raster->tiles_y;
+    uint32_t *start = raster->start;
+    int x0, y0, x1, y1;
+
+    memset(start, 0, (tiles + 1) * sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < raster->shape_count; ++i) {
+        if (!tileRange(raster, raster->shapes[i].box, &x0, &y0, &x1, &y1))
+            continue;
+        for (int ty = y0; ty <= y1; ++ty)
+            for (int tx = x0; tx <= x1; ++tx) {
+                uint32_t tile = ty * raster->tiles_x + tx;
+                if (raster->dirty[tile]) start[tile + 1]++;
+            }
+    }
+
+    for (uint32_t i = 0; i < tiles; ++i) start[i + 1] += start[i];
+
+    // start[i] is used as the insert point and ends up at the next tile's
+    // start, shift it back after
+    for (uint32_t i = 0; i < raster->shape_count; ++i) {
+        if (!tileRange(raster, raster->shapes[i].box, &x0, &y0, &x1, &y1))
+            continue;
+        for (int ty = y0; ty <= y1; ++ty)
+            for (int tx = x0; tx <= x1; ++tx) {
+                uint32_t tile = ty * raster->tiles_x + tx;
+                if (raster->dirty[tile]) raster->bins[start[tile]++] = i;
+            }
+    }
+    memmove(start + 1, start, tiles * sizeof(uint32_t));
+    start[0] = 0;
+}
+
+void
+Raster_Draw(Raster *raster,
+            const SDL_Rect *rects,
+            uint32_t count,
+            uint32_t background)
+// Redraws every tile that overlaps one of rects, or all of them if rects is
+// NULL, from the shapes added since Raster_Clear.
+{
+    uint32_t tiles = raster->tiles_x * raster->tiles_y;
+    int x0, y0, x1, y1;
+
+    raster->background = background;
+    raster->tile_count = 0;
+    memset(raster->dirty, rects == NULL, tiles * sizeof(bool));
+
+    for (uint32_t i = 0; rects && i < count; ++i) {
+        if (!tileRange(raster, rects[i], &x0, &y0, &x1, &y1)) continue;
+        for (int ty = y0; ty <= y1; ++ty)
+            for (int tx = x0; tx <= x1; ++tx)
+                raster->dirty[ty * raster->tiles_x + tx] = true;
+    }
+
+    for (uint32_t i = 0; i < tiles; ++i)
+        if (raster->dirty[i]) raster->tiles[raster->tile_count++] = i;
+
+    if (raster->tile_count == 0) return;
+    bin(raster);
+
+    if (raster->pool)
+        Pool_Run(raster->pool, raster->tile_count, drawTile, raster);
+    else
+        for (uint32_t i = 0; i < raster->tile_count; ++i)
+            drawTile(raster, i, 0);
+}
@@ -0,0 +1,66 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <SDL2/SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pool.h"
+
+// Draws straight into a 32 bit surface on all the pool's threads. The screen is
+// split into RASTER_TILE square tiles and every shape is put in the bin of each
+// tile its box overlaps. Each tile is then drawn by one thread from start to
+// finish, clear included, so no two threads ever write the same pixel and
+// nothing needs a lock. Shapes in a tile are drawn in the order they were
+// added.
+
+#define RASTER_TILE 64
+
+enum {RASTER_RECT, RASTER_SEGMENT, RASTER_RING, RASTER_DISC};
+
+typedef struct _Shape {
+    uint8_t kind;
+    // rect: top left and size, segment: the end points, ring and disc: the
+    // centre, radius and ring width
+    float a, b, c, d;
+    uint32_t color; // already in the surface's pixel format
+    SDL_Rect box; // pixels it can touch
+} Shape;
+
+typedef struct _Raster {
+    SDL_Surface *target;
+    Pool *pool;
+    uint32_t tiles_x, tiles_y;
+
+    Shape *shapes;
+    uint32_t shape_count;
+    uint32_t shape_capacity;
+
+    // shape indices sorted by tile, tile i has bins[start[i]] up to
+    // bins[start[i + 1]]
+    uint32_t *start;
+    uint32_t *bins;
+    uint32_t bin_capacity;
+
+    bool *dirty; // tiles to draw this time
+    uint32_t *tiles; // the dirty ones, for the pool
+    uint32_t tile_count;
+    uint32_t background;
+} Raster;
+
+bool Raster_Init(Raster *raster, SDL_Surface *target, uint32_t shapes,
+                 Pool *pool);
+void Raster_Free(Raster *raster);
+void Raster_Clear(Raster *raster);
+void Raster_Rect(Raster *raster, float x, float y, float w, float h,
+                 uint32_t color);
+void Raster_Segment(Raster *raster, float x0, float y0, float x1, float y1,
+                    uint32_t color);
+void Raster_Ring(Raster *raster, float x, float y, float radius, float width,
+                 uint32_t color);
+void Raster_Disc(Raster *raster, float x, float y, float radius,
+                 uint32_t color);
+void Raster_Draw(Raster *raster, const SDL_Rect *rects, uint32_t count,
+                 uint32_t background);
+
+#endif
@@ -0,0 +1,874 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "slabs.h"
+#include "world.h"
+#include "arena.h"
+
+#define SLABS_DT 0.016f
+
+// What goes over the sockets. The coordinator asks, a slab answers the ones
+// with an arrow. Halos go straight between neighbouring slabs as SLAB_BALLS.
+enum {
+    SLAB_REPORT, // -> SLAB_SPEED
+    SLAB_INTEGRATE, // a is the substep
+    SLAB_GHOSTS, // a is the halo width, trade halos -> SLAB_TAINTED
+    SLAB_COMMIT, // keep what the last SLAB_GHOSTS worked out
+    SLAB_MIGRATE, // -> SLAB_BALLS, its balls now in another slab, gone from it
+    SLAB_ARRIVE, // balls that moved into the slab
+    SLAB_GATHER, // -> SLAB_BALLS, all of them
+    SLAB_QUIT,
+    SLAB_SPEED, // a is the fastest speed, b the smallest radius
+    SLAB_BALLS,
+    SLAB_TAINTED, // a is how many of its balls may be wrong, b the halo
+};
+
+typedef struct _SlabMessage {
+    uint32_t type;
+    uint32_t count; // balls that come after it
+    float a, b;
+} SlabMessage;
+
+typedef struct _SlabBall {
+    Ball ball;
+    uint32_t id;
+} SlabBall;
+
+typedef struct _SlabList {
+    SlabBall *balls;
+    uint32_t count;
+    uint32_t capacity;
+} SlabList;
+
+// one process's part
+typedef struct _Slab {
+    uint32_t index;
+    uint32_t slabs;
+    float x0, x1; // the first and last slab go on to the walls
+    float width, height;
+    float reach; // farthest apart two balls can touch, twice the biggest radius
+    int fd;
+    int left, right; // sockets to the slabs next to it, -1 at the ends
+    SlabList owned;
+    SlabList in; // what the last message brought
+    SlabList out;
+    SlabList ghosts; // the halo
+
+    // the owned balls first, then the halo, stepped together
+    Arena arena;
+    World world;
+    uint32_t capacity;
+    uint8_t *ball_taint;
+    uint8_t *color_taint;
+    uint8_t *contact_taint;
+} Slab;
+
+// the coordinator's side
+typedef struct _Slabs {
+    uint32_t slabs;
+    int fds[SLABS_MAX];
+    pid_t pids[SLABS_MAX];
+    SlabList lists[SLABS_MAX]; // what each slab sent last
+    SlabList out;
+    const World *world; // the whole world, for its settings
+    float reach;
+    uint64_t halo_balls; // taken in by the slabs, over all substeps and tries
+    uint64_t retries;
+    uint64_t moved;
+} Slabs;
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void
+edges(uint32_t index,
+      uint32_t slabs,
+      float width,
+      float *x0,
+      float *x1)
+{
+    *x0 = width * index / slabs;
+    *x1 = width * (index + 1) / slabs;
+}
+
+static uint32_t
+slabOf(float x,
+       uint32_t slabs,
+       float width)
+{
+    float slab = floorf(x * slabs / width);
+
+    if (!(slab >= 0)) return 0;
+    if (slab >= slabs) return slabs - 1;
+    return slab;
+}
+
+static bool
+add(SlabList *list,
+    const Ball *ball,
+    uint32_t id)
+{
+    if (list->count == list->capacity) {
+        uint32_t capacity = list->capacity ? list->capacity * 2 : 256;
+        SlabBall *balls = realloc(list->balls, capacity * sizeof(SlabBall));
+
+        if (!balls) return false;
+        list->balls = balls;
+        list->capacity = capacity;
+    }
+
+    list->balls[list->count++] = (SlabBall) {.ball = *ball, .id = id};
+    return true;
+}
+
+static bool
+writeAll(int fd,
+         const void *data,
+         size_t size)
+// not write(), a slab that died must not take the coordinator with SIGPIPE
+{
+    const uint8_t *p = data;
+
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static bool
+readAll(int fd,
+        void *data,
+        size_t size)
+{
+    uint8_t *p = data;
+
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static bool
+sendMessage(int fd,
+            uint32_t type,
+            float a,
+            float b,
+            const SlabList *list)
+{
+    SlabMessage message = {
+        .type = type,
+        .count = list ? list->count : 0,
+        .a = a,
+        .b = b,
+    };
+
+    return writeAll(fd, &message, sizeof(message)) &&
+           (!list || writeAll(fd, list->balls,
+                              list->count * sizeof(SlabBall)));
+}
+
+static bool
+receiveMessage(int fd,
+               SlabMessage *message,
+               SlabList *list)
+// The balls replace what was in list.
+{
+    if (!readAll(fd, message, sizeof(*message))) return false;
+
+    list->count = 0;
+    if (message->count > list->capacity) {
+        SlabBall *balls = realloc(list->balls,
+                                  message->count * sizeof(SlabBall));
+
+        if (!balls) return false;
+        list->balls = balls;
+        list->capacity = message->count;
+    }
+
+    if (!readAll(fd, list->balls, message->count * sizeof(SlabBall)))
+        return false;
+    list->count = message->count;
+    return true;
+}
+
+static bool
+reserve(Slab *slab,
+        uint32_t count)
+// Room in the slab's world for count balls, it is made again bigger when
+// there is not.
+{
+    if (count <= slab->capacity) return true;
+
+    uint32_t capacity = count < 512 ? 1024 : count * 2;
+    size_t size = World_Size(capacity) + World_ObstaclesSize(NULL) +
+                  capacity * (2 + WORLD_CONTACTS_PER_BALL) + 1024;
+
+    if (slab->capacity) Arena_Free(&slab->arena);
+    slab->capacity = 0;
+
+    if (!Arena_Init(&slab->arena, size)) return false;
+    if (!World_Init(&slab->world, &slab->arena, capacity, slab->width,
+                    slab->height) ||
+        !World_InitObstacles(&slab->world, &slab->arena, NULL)) {
+        Arena_Free(&slab->arena);
+        return false;
+    }
+
+    slab->ball_taint = Arena_Alloc(&slab->arena, capacity);
+    slab->color_taint = Arena_Alloc(&slab->arena, capacity);
+    slab->contact_taint = Arena_Alloc(&slab->arena, capacity *
+                                                   WORLD_CONTACTS_PER_BALL);
+    if (!slab->ball_taint || !slab->color_taint || !slab->contact_taint) {
+        Arena_Free(&slab->arena);
+        return false;
+    }
+
+    slab->capacity = capacity;
+    return true;
+}
+
+static bool
+integrate(Slab *slab,
+          float dt)
+// Every ball moves on its own, so the slab's balls are moved alone and the
+// halo comes in already moved.
+{
+    World *world = &slab->world;
+    SlabList *owned = &slab->owned;
+
+    if (!reserve(slab, owned->count)) return false;
+
+    world->ball_count = owned->count;
+    for (uint32_t i = 0; i < owned->count; ++i)
+        world->balls[i] = owned->balls[i].ball;
+    World_Integrate(world, dt);
+    for (uint32_t i = 0; i < owned->count; ++i)
+        owned->balls[i].ball = world->balls[i];
+
+    return true;
+}
+
+static bool
+forward(Slab *slab,
+        const SlabList *list,
+        float edge,
+        bool rightward)
+{
+    for (uint32_t i = 0; i < list->count; ++i) {
+        const SlabBall *b = &list->balls[i];
+
+        if ((b->ball.px >= edge) == rightward &&
+            !add(&slab->out, &b->ball, b->id))
+            return false;
+    }
+
+    return true;
+}
+
+static bool
+pass(Slab *slab,
+     float halo,
+     bool rightward)
+// One way of a halo trade. Takes the balls from the neighbour on one side,
+// passes on to the other side its own and those it got that the slabs there
+// could need, and keeps the ones it got that are in its halo.
+{
+    int from = rightward ? slab->left : slab->right;
+    int to = rightward ? slab->right : slab->left;
+    // the next slab's halo starts at edge, this one's ends at far
+    float edge = rightward ? slab->x1 - halo : slab->x0 + halo;
+    float far = rightward ? slab->x1 + halo : slab->x0 - halo;
+    // nothing is further on than the end of the row
+    bool end = to < 0;
+    SlabMessage message;
+
+    slab->in.count = 0;
+    if (from >= 0 && (!receiveMessage(from, &message, &slab->in) ||
+                      message.type != SLAB_BALLS))
+        return false;
+
+    slab->out.count = 0;
+    if (!end && (!forward(slab, &slab->owned, edge, rightward) ||
+                 !forward(slab, &slab->in, edge, rightward) ||
+                 !sendMessage(to, SLAB_BALLS, 0, 0, &slab->out)))
+        return false;
+
+    for (uint32_t i = 0; i < slab->in.count; ++i) {
+        const SlabBall *b = &slab->in.balls[i];
+
+        if ((end || (b->ball.px >= far) != rightward) &&
+            !add(&slab->ghosts, &b->ball, b->id))
+            return false;
+    }
+
+    return true;
+}
+
+static bool
+exchange(Slab *slab,
+         float halo)
+// The slab gets every ball between x0 - halo and x1 + halo it does not own.
+// Halos go along the row of slabs, left to right with each slab waiting for
+// the one before it, then back, so no two slabs ever wait on each other. A
+// halo wider than a slab is passed on over more than one.
+{
+    slab->ghosts.count = 0;
+    return pass(slab, halo, true) && pass(slab, halo, false);
+}
+
+static uint32_t
+tainted(Slab *slab,
+        float halo)
+// The slab has every ball between x0 - halo and x1 + halo. A ball closer to
+// those edges than reach could touch one it does not have, so the contacts it
+// has may be short one, which would change the colours picked after it and
+// what the solve does to it. That is followed through the colouring in the
+// order it was done and through both solves in theirs, anything touching a
+// ball that may be wrong may be wrong too. Returns how many of the slab's own
+// balls may be.
+{
+    World *world = &slab->world;
+    uint8_t *balls = slab->ball_taint;
+    uint8_t *colors = slab->color_taint;
+    uint8_t *contacts = slab->contact_taint;
+    float left = slab->x0 - halo;
+    float right = slab->x1 + halo;
+    uint32_t cursor[WORLD_COLORS];
+    uint32_t count = 0;
+
+    // nothing gets through the walls, past them there is nothing to miss
+    bool open_left = slab->index > 0 && left > -WORLD_WALL_SIZE;
+    bool open_right = slab->index + 1 < slab->slabs &&
+                      right < slab->width + WORLD_WALL_SIZE;
+
+    for (uint32_t i = 0; i < world->ball_count; ++i) {
+        float x = world->balls[i].px;
+
+        balls[i] = (open_left && x < left + slab->reach) ||
+                   (open_right && x >= right - slab->reach);
+        colors[i] = balls[i];
+    }
+
+    // contacts are in the order they were coloured, contact_taint is by
+    // where each went in colored
+    memcpy(cursor, world->color_start, sizeof(cursor));
+    for (uint32_t i = 0; i < world->contact_count; ++i) {
+        const Contact *c = &world->contacts[i];
+        uint32_t k = cursor[c->color]++;
+
+        contacts[k] = colors[c->a] | colors[c->b];
+        if (contacts[k]) colors[c->a] = colors[c->b] = 1;
+    }
+
+    // separate, then bounce
+    for (uint32_t pass = 0; pass < 2; ++pass) {
+        for (uint32_t k = 0; k < world->contact_count; ++k) {
+            const Contact *c = &world->colored[k];
+
+            if (balls[c->a] | balls[c->b] | contacts[k])
+                balls[c->a] = balls[c->b] = 1;
+        }
+    }
+
+    for (uint32_t i = 0; i < slab->owned.count; ++i) count += balls[i];
+    return count;
+}
+
+static bool
+collide(Slab *slab,
+        float halo)
+// The rest of the substep on its balls and the halo in.
+{
+    World *world = &slab->world;
+    const SlabList *owned = &slab->owned;
+    const SlabList *ghosts = &slab->ghosts;
+
+    if (!exchange(slab, halo) ||
+        !reserve(slab, owned->count + ghosts->count))
+        return false;
+
+    world->ball_count = owned->count + ghosts->count;
+    for (uint32_t i = 0; i < owned->count; ++i) {
+        world->balls[i] = owned->balls[i].ball;
+        world->ball_ids[i] = owned->balls[i].id;
+    }
+    for (uint32_t i = 0; i < ghosts->count; ++i) {
+        world->balls[owned->count + i] = ghosts->balls[i].ball;
+        world->ball_ids[owned->count + i] = ghosts->balls[i].id;
+    }
+
+    // ids are the whole world's, ball_index is not kept up and World_Ball
+    // cannot be used
+    World_Collide(world);
+
+    return sendMessage(slab->fd, SLAB_TAINTED, tainted(slab, halo),
+                       ghosts->count, NULL);
+}
+
+static bool
+migrate(Slab *slab)
+{
+    SlabList *owned = &slab->owned;
+    uint32_t kept = 0;
+
+    slab->out.count = 0;
+    for (uint32_t i = 0; i < owned->count; ++i) {
+        const SlabBall *b = &owned->balls[i];
+
+        if (slabOf(b->ball.px, slab->slabs, slab->width) == slab->index)
+            owned->balls[kept++] = *b;
+        else if (!add(&slab->out, &b->ball, b->id))
+            return false;
+    }
+    owned->count = kept;
+
+    return sendMessage(slab->fd, SLAB_BALLS, 0, 0, &slab->out);
+}
+
+static bool
+report(Slab *slab)
+{
+    float fastest = 0;
+    float smallest = INFINITY;
+
+    for (uint32_t i = 0; i < slab->owned.count; ++i) {
+        const Ball *b = &slab->owned.balls[i].ball;
+        fastest = fmaxf(fastest, b->vx * b->vx + b->vy * b->vy);
+        smallest = fminf(smallest, Ball_Radius(b));
+    }
+
+    return sendMessage(slab->fd, SLAB_SPEED, sqrtf(fastest), smallest, NULL);
+}
+
+static bool
+serve(Slab *slab)
+// A slab's process, until it is told to quit or the coordinator goes away.
+{
+    SlabMessage message;
+
+    for (;;) {
+        bool ok = true;
+
+        if (!receiveMessage(slab->fd, &message, &slab->in)) return false;
+
+        switch (message.type) {
+        case SLAB_REPORT:
+            ok = report(slab);
+            break;
+        case SLAB_INTEGRATE:
+            ok = integrate(slab, message.a);
+            break;
+        case SLAB_GHOSTS:
+            ok = collide(slab, message.a);
+            break;
+        case SLAB_COMMIT:
+            for (uint32_t i = 0; i < slab->owned.count; ++i)
+                slab->owned.balls[i].ball = slab->world.balls[i];
+            break;
+        case SLAB_MIGRATE:
+            ok = migrate(slab);
+            break;
+        case SLAB_ARRIVE:
+            for (uint32_t i = 0; ok && i < slab->in.count; ++i)
+                ok = add(&slab->owned, &slab->in.balls[i].ball,
+                         slab->in.balls[i].id);
+            break;
+        case SLAB_GATHER:
+            ok = sendMessage(slab->fd, SLAB_BALLS, 0, 0, &slab->owned);
+            break;
+        case SLAB_QUIT:
+            return true;
+        default:
+            return false;
+        }
+
+        if (!ok) return false;
+    }
+}
+
+static bool
+runSlab(const World *start,
+        uint32_t index,
+        uint32_t slabs,
+        int fd,
+        int left,
+        int right,
+        float reach)
+// In the slab's process, start is the coordinator's copy of the world as it
+// was when it forked, only the slab's balls are taken from it.
+{
+    Slab slab = {
+        .index = index,
+        .slabs = slabs,
+        .width = start->width,
+        .height = start->height,
+        .reach = reach,
+        .fd = fd,
+        .left = left,
+        .right = right,
+    };
+    bool ok = true;
+
+    edges(index, slabs, slab.width, &slab.x0, &slab.x1);
+    for (uint32_t i = 0; ok && i < start->ball_count; ++i) {
+        const Ball *b = &start->balls[i];
+
+        if (slabOf(b->px, slabs, slab.width) == index)
+            ok = add(&slab.owned, b, start->ball_ids[i]);
+    }
+
+    ok = ok && serve(&slab);
+
+    if (slab.capacity) Arena_Free(&slab.arena);
+    free(slab.owned.balls);
+    free(slab.in.balls);
+    free(slab.out.balls);
+    free(slab.ghosts.balls);
+    return ok;
+}
+
+static void
+stop(Slabs *slabs)
+{
+    for (uint32_t i = 0; i < slabs->slabs; ++i) {
+        sendMessage(slabs->fds[i], SLAB_QUIT, 0, 0, NULL);
+        close(slabs->fds[i]);
+    }
+    for (uint32_t i = 0; i < slabs->slabs; ++i) {
+        waitpid(slabs->pids[i], NULL, 0);
+        free(slabs->lists[i].balls);
+    }
+    free(slabs->out.balls);
+    slabs->slabs = 0;
+}
+
+static void
+closeLinks(int links[][2],
+           uint32_t count,
+           int left,
+           int right)
+// every end of the sockets between slabs but left and right
+{
+    for (uint32_t i = 0; i + 1 < count; ++i)
+        for (uint32_t k = 0; k < 2; ++k)
+            if (links[i][k] != left && links[i][k] != right)
+                close(links[i][k]);
+}
+
+static bool
+spawn(Slabs *slabs,
+      const World *world,
+      uint32_t count,
+      float reach)
+// A process and a socket pair to the coordinator for each slab, and a socket
+// pair between each slab and the next for the halos.
+{
+    // links[i] joins slab i, end 0, to slab i + 1, end 1
+    int links[SLABS_MAX][2];
+
+    *slabs = (Slabs) {.world = world, .reach = reach};
+
+    for (uint32_t i = 0; i + 1 < count; ++i) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, links[i]) != 0) {
+            perror("socketpair");
+            closeLinks(links, i + 1, -1, -1);
+            return false;
+        }
+    }
+
+    // or the children print what is still buffered again
+    fflush(stdout);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        int pair[2];
+
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+            perror("socketpair");
+            closeLinks(links, count, -1, -1);
+            stop(slabs);
+            return false;
+        }
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            close(pair[0]);
+            close(pair[1]);
+            closeLinks(links, count, -1, -1);
+            stop(slabs);
+            return false;
+        }
+
+        if (pid == 0) {
+            int left = i > 0 ? links[i - 1][1] : -1;
+            int right = i + 1 < count ? links[i][0] : -1;
+
+            close(pair[0]);
+            for (uint32_t j = 0; j < i; ++j) close(slabs->fds[j]);
+            closeLinks(links, count, left, right);
+            _exit(runSlab(world, i, count, pair[1], left, right, reach) ?
+                  0 : 1);
+        }
+
+        close(pair[1]);
+        slabs->fds[i] = pair[0];
+        slabs->pids[i] = pid;
+        slabs->slabs = i + 1;
+    }
+
+    // only the slabs hold them, so one that dies wakes its neighbours
+    closeLinks(links, count, -1, -1);
+    return true;
+}
+
+static bool
+broadcast(Slabs *slabs,
+          uint32_t type,
+          float a)
+{
+    for (uint32_t i = 0; i < slabs->slabs; ++i)
+        if (!sendMessage(slabs->fds[i], type, a, 0, NULL)) return false;
+    return true;
+}
+
+static bool
+collect(Slabs *slabs,
+        uint32_t type,
+        SlabMessage *messages)
+// Every slab's answer, the balls go in lists.
+{
+    for (uint32_t i = 0; i < slabs->slabs; ++i)
+        if (!receiveMessage(slabs->fds[i], &messages[i], &slabs->lists[i]) ||
+            messages[i].type != type)
+            return false;
+    return true;
+}
+
+static bool
+substep(Slabs *slabs,
+        float dt)
+// Halos start at twice reach and double until no slab has an own ball that
+// might be wrong.
+{
+    SlabMessage messages[SLABS_MAX];
+    uint32_t count = slabs->slabs;
+
+    if (!broadcast(slabs, SLAB_INTEGRATE, dt)) return false;
+
+    for (float halo = 2 * slabs->reach;; halo *= 2) {
+        if (!broadcast(slabs, SLAB_GHOSTS, halo) ||
+            !collect(slabs, SLAB_TAINTED, messages))
+            return false;
+
+        bool wrong = false;
+        for (uint32_t j = 0; j < count; ++j) {
+            wrong |= messages[j].a > 0;
+            slabs->halo_balls += messages[j].b;
+        }
+        if (!wrong) return broadcast(slabs, SLAB_COMMIT, 0);
+
+        slabs->retries++;
+    }
+}
+
+static bool
+step(Slabs *slabs,
+     float dt)
+// Substeps as World_Step would pick them for all the balls, then the balls
+// that left a slab move.
+{
+    SlabMessage messages[SLABS_MAX];
+    uint32_t count = slabs->slabs;
+    float width = slabs->world->width;
+    float fastest = 0;
+    float smallest = INFINITY;
+
+    if (!broadcast(slabs, SLAB_REPORT, 0) ||
+        !collect(slabs, SLAB_SPEED, messages))
+        return false;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        fastest = fmaxf(fastest, messages[i].a);
+        smallest = fminf(smallest, messages[i].b);
+    }
+
+    uint32_t substeps = World_Substeps(slabs->world, fastest, smallest, dt);
+    for (uint32_t i = 0; i < substeps; ++i)
+        if (!substep(slabs, dt / substeps)) return false;
+
+    if (!broadcast(slabs, SLAB_MIGRATE, 0) ||
+        !collect(slabs, SLAB_BALLS, messages))
+        return false;
+
+    for (uint32_t j = 0; j < count; ++j) {
+        slabs->out.count = 0;
+        for (uint32_t k = 0; k < count; ++k) {
+            for (uint32_t i = 0; i < slabs->lists[k].count; ++i) {
+                const SlabBall *b = &slabs->lists[k].balls[i];
+
+                if (slabOf(b->ball.px, count, width) == j &&
+                    !add(&slabs->out, &b->ball, b->id))
+                    return false;
+            }
+        }
+
+        slabs->moved += slabs->out.count;
+        if (!sendMessage(slabs->fds[j], SLAB_ARRIVE, 0, 0, &slabs->out))
+            return false;
+    }
+
+    return true;
+}
+
+static int64_t
+compare(Slabs *slabs,
+        World *whole)
+// Balls that are not bit for bit what the whole world has, -1 if the slabs
+// could not be asked.
+{
+    SlabMessage messages[SLABS_MAX];
+    uint32_t total = 0;
+    int64_t different = 0;
+
+    if (!broadcast(slabs, SLAB_GATHER, 0) ||
+        !collect(slabs, SLAB_BALLS, messages))
+        return -1;
+
+    for (uint32_t k = 0; k < slabs->slabs; ++k) {
+        for (uint32_t i = 0; i < slabs->lists[k].count; ++i) {
+            const SlabBall *b = &slabs->lists[k].balls[i];
+
+            // position and velocity, the rest never changes or follows
+            // from them
+            if (b->id >= whole->ball_count ||
+                memcmp(&b->ball, World_Ball(whole, b->id),
+                       4 * sizeof(float)) != 0)
+                different++;
+        }
+        total += slabs->lists[k].count;
+    }
+
+    // lost or doubled balls
+    if (total != whole->ball_count)
+        different += llabs((int64_t)total - whole->ball_count);
+    return different;
+}
+
+static uint32_t
+nextSplit(uint32_t p,
+          uint32_t procs)
+// doubles, with procs itself after the last power of two below it
+{
+    return p < procs && p * 2 > procs ? procs : p * 2;
+}
+
+static bool
+makeWorld(World *world,
+          Arena *arena,
+          uint32_t balls,
+          float side)
+{
+    if (!World_Init(world, arena, balls, side, side) ||
+        !World_InitObstacles(world, arena, NULL))
+        return false;
+
+    World_Scatter(world, 1, 3, 6, 200, 1);
+    return true;
+}
+
+bool
+Slabs_Run(uint32_t balls,
+          uint32_t procs,
+          uint32_t steps)
+// Steps a pile in a box as one world, then split into 1, 2, 4 ... slabs and
+// procs slabs last, and prints a table. Every split has to end with the same
+// balls as the whole world.
+{
+    Arena arena;
+    World start, whole;
+    // about 40% of the world is covered
+    float side = sqrtf(balls) * 12;
+    float biggest = 0;
+    bool ok = true;
+
+    if (procs == 0) procs = 1;
+    if (procs > SLABS_MAX) procs = SLABS_MAX;
+    if (!Arena_Init(&arena, 2 * (World_Size(balls) +
+                                 World_ObstaclesSize(NULL)) + 1024))
+        return false;
+
+    if (!makeWorld(&start, &arena, balls, side) ||
+        !makeWorld(&whole, &arena, balls, side)) {
+        Arena_Free(&arena);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < start.ball_count; ++i)
+        biggest = fmaxf(biggest, Ball_Radius(&start.balls[i]));
+
+    double begin = now();
+    for (uint32_t i = 0; i < steps; ++i) World_Step(&whole, SLABS_DT);
+    double ms = (now() - begin) / steps;
+
+    printf("%u balls, %u steps, one process %.3f ms/step\n", balls, steps, ms);
+    printf("slabs  ms/step  halo balls/step  retries  moved/step  balls\n");
+
+    for (uint32_t p = 1; ok && p <= procs; p = nextSplit(p, procs)) {
+        Slabs slabs;
+
+        if (!spawn(&slabs, &start, p, 2 * biggest)) {
+            ok = false;
+            break;
+        }
+
+        begin = now();
+        for (uint32_t i = 0; ok && i < steps; ++i) ok = step(&slabs, SLABS_DT);
+        ms = (now() - begin) / steps;
+
+        int64_t different = ok ? compare(&slabs, &whole) : -1;
+        ok = different >= 0;
+
+        if (ok) {
+            char result[32] = "same";
+
+            if (different > 0)
+                snprintf(result, sizeof(result), "%lld DIFFERENT",
+                         (long long)different);
+            printf("%5u  %7.3f  %15.1f  %7lu  %10.2f  %s\n", p, ms,
+                   slabs.halo_balls / (double)steps,
+                   (unsigned long)slabs.retries, slabs.moved / (double)steps,
+                   result);
+        } else {
+            fprintf(stderr, "slabs: lost a slab process\n");
+        }
+
+        stop(&slabs);
+    }
+
+    Arena_Free(&arena);
+    return ok;
+}
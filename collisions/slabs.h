@@ -0,0 +1,28 @@
+#ifndef SLABS_H
+#define SLABS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Runs one world as several processes on one machine, each owning a slab of
+// it: a strip across x, the world's width divided by the number of processes.
+// A process only holds its own balls and copies of the balls near its edges
+// (the halo) that it gets from the others every substep. Balls that end a
+// step in another slab move there. The processes talk over Unix domain
+// sockets. Each slab trades halos with the slabs next to it, and a
+// coordinator passes movers on and decides the substeps. No process has the
+// whole world.
+//
+// A slab steps its balls plus the halo with the same code as a whole world
+// and keeps the results for its own balls. A ball near the outer edge of the
+// halo could be touching a ball the slab does not have, so the slab follows
+// what that could have changed through the colouring and the solve, and if
+// it reaches one of its own balls the substep is done again by everybody
+// with a halo twice as wide. What is kept is then exactly what one process
+// stepping the whole world gets, bit for bit.
+
+#define SLABS_MAX 64
+
+bool Slabs_Run(uint32_t balls, uint32_t procs, uint32_t steps);
+
+#endif
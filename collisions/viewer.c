@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <SDL2/SDL.h>
+
+#include "publish.h"
+#include "raster.h"
+#include "pool.h"
+#include "pacer.h"
+
+// Watches a world another process publishes (./balls publish, or the game
+// with BALLS_PUBLISH set) and draws the newest frame it has with the same
+// raster as the game. The shared memory is mapped read only, the viewer can
+// come and go and the world never waits for it.
+//
+//   ./viewer [NAME]
+
+#define VIEWER_FPS 60
+
+#define END(check, str1, str2) \
+    if (check) { \
+        assert(check); \
+        fprintf(stderr, "%s\n%s", str1, str2); \
+        exit(1); \
+    } \
+
+#define SDL_main main
+
+typedef struct _Viewer {
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    SDL_Surface *backbuffer;
+    SDL_Texture *screen;
+    Publish publish;
+    Pool pool;
+    Raster raster;
+    Pacer pacer;
+} Viewer;
+
+static void
+draw(Viewer *viewer)
+// Balls only, obstacles are not published.
+{
+    SDL_PixelFormat *format = viewer->backbuffer->format;
+    Raster *raster = &viewer->raster;
+
+    Raster_Clear(raster);
+    for (uint32_t i = 0; i < viewer->publish.ball_count; ++i) {
+        const PublishedBall *b = &viewer->publish.balls[i];
+        uint32_t color = SDL_MapRGBA(format, b->color >> 24, b->color >> 16,
+                                     b->color >> 8, b->color);
+
+        Raster_Ring(raster, b->x, b->y, b->radius, 2, color);
+    }
+    Raster_Draw(raster, NULL, 0, SDL_MapRGBA(format, 0, 0, 0, 0));
+
+    SDL_UpdateTexture(viewer->screen, NULL, viewer->backbuffer->pixels,
+                      viewer->backbuffer->pitch);
+}
+
+int
+main(int argc,
+     char **argv)
+{
+    static Viewer viewer;
+    const char *name = argc >= 2 ? argv[1] : PUBLISH_NAME;
+    bool quit = false;
+    SDL_Event event;
+
+    END(!Publish_Open(&viewer.publish, name), "Publish_Open()",
+        "nothing is publishing, start ./balls publish first");
+
+    int w = viewer.publish.header->width;
+    int h = viewer.publish.header->height;
+
+    END(SDL_Init(SDL_INIT_VIDEO) != 0, "Could not initialize SDL",
+        SDL_GetError());
+
+    viewer.window = SDL_CreateWindow(name, SDL_WINDOWPOS_UNDEFINED,
+                                     SDL_WINDOWPOS_UNDEFINED, w, h,
+                                     SDL_WINDOW_SHOWN);
+    END(viewer.window == NULL, "Could not create window", SDL_GetError());
+
+    viewer.renderer = SDL_CreateRenderer(viewer.window, -1,
+                                         SDL_RENDERER_ACCELERATED);
+    END(viewer.renderer == NULL, "Could not create renderer", SDL_GetError());
+
+    viewer.backbuffer = SDL_CreateRGBSurface(0, w, h, 32, 0xFF000000,
+                                             0x00FF0000, 0x0000FF00,
+                                             0x000000FF);
+    END(viewer.backbuffer == NULL, "Could not create surface",
+        SDL_GetError());
+
+    viewer.screen = SDL_CreateTexture(viewer.renderer,
+                                      SDL_PIXELFORMAT_RGBA8888,
+                                      SDL_TEXTUREACCESS_STREAMING, w, h);
+    END(viewer.screen == NULL, "Could not create texture", SDL_GetError());
+
+    END(!Pool_Init(&viewer.pool, 0), "Pool_Init()", "could not start threads");
+    END(!Raster_Init(&viewer.raster, viewer.backbuffer,
+                     viewer.publish.header->capacity, &viewer.pool),
+        "Raster_Init()", "could not allocate the raster");
+
+    Pacer_Init(&viewer.pacer, VIEWER_FPS, false);
+
+    while (!quit) {
+        while (SDL_PollEvent(&event))
+            if (event.type == SDL_QUIT) quit = true;
+
+        // frames that came and went since the last look are skipped
+        if (Publish_Read(&viewer.publish)) draw(&viewer);
+
+        SDL_RenderCopy(viewer.renderer, viewer.screen, NULL, NULL);
+        SDL_RenderPresent(viewer.renderer);
+        Pacer_Wait(&viewer.pacer);
+    }
+
+    Raster_Free(&viewer.raster);
+    Pool_Free(&viewer.pool);
+    Publish_Close(&viewer.publish);
+    SDL_DestroyTexture(viewer.screen);
+    SDL_FreeSurface(viewer.backbuffer);
+    SDL_DestroyRenderer(viewer.renderer);
+    SDL_DestroyWindow(viewer.window);
+    SDL_Quit();
+    return 0;
+}
@@ -0,0 +1,959 @@
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include "world.h"
+
+size_t
+World_Size(uint32_t ball_count)
+// arena space needed by World_Init, with room for alignment
+{
+    return ball_count * (2 * sizeof(Ball) + 5 * sizeof(uint32_t) +
+                         sizeof(uint64_t) +
+                         (2 * WORLD_CONTACTS_PER_BALL +
+                          WORLD_CANDIDATES_PER_BALL) * sizeof(Contact) +
+                         WORLD_CELLS_PER_BALL * sizeof(uint32_t)) + 512;
+}
+
+bool
+World_Init(World *world,
+           Arena *arena,
+           uint32_t ball_count,
+           float width,
+           float height)
+{
+    *world = (World) {
+        .ball_count = ball_count,
+        .contact_capacity = ball_count * WORLD_CONTACTS_PER_BALL,
+        .candidate_capacity = ball_count * WORLD_CANDIDATES_PER_BALL,
+        .cell_capacity = ball_count * WORLD_CELLS_PER_BALL,
+        .width = width,
+        .height = height,
+        .drag = 0.8f,
+        .mass_factor = 10,
+        .restitution = 1,
+        .rest_speed = 0.1f,
+        .cfl = 0.5f,
+        .seed = 1,
+    };
+
+    world->balls = Arena_Alloc(arena, ball_count * sizeof(Ball));
+    world->sorted = Arena_Alloc(arena, ball_count * sizeof(Ball));
+    world->morton = Arena_Alloc(arena, ball_count * sizeof(uint64_t));
+    world->ball_ids = Arena_Alloc(arena, ball_count * sizeof(uint32_t));
+    world->ball_index = Arena_Alloc(arena, ball_count * sizeof(uint32_t));
+    world->contacts = Arena_Alloc(arena,
+                                  world->contact_capacity * sizeof(Contact));
+    world->colored = Arena_Alloc(arena,
+                                 world->contact_capacity * sizeof(Contact));
+    world->candidates = Arena_Alloc(arena, world->candidate_capacity *
+                                           sizeof(Contact));
+    world->ball_colors = Arena_Alloc(arena, ball_count * sizeof(uint32_t));
+    world->cell_start = Arena_Alloc(arena, (world->cell_capacity + 1) *
+                                           sizeof(uint32_t));
+    world->cell_balls = Arena_Alloc(arena, ball_count * sizeof(uint32_t));
+    world->ball_cells = Arena_Alloc(arena, ball_count * sizeof(uint32_t));
+
+    if (!world->balls || !world->sorted || !world->morton ||
+        !world->ball_ids || !world->ball_index || !world->contacts ||
+        !world->colored || !world->candidates || !world->ball_colors ||
+        !world->cell_start || !world->cell_balls || !world->ball_cells)
+        return false;
+
+    for (uint32_t i = 0; i < ball_count; ++i) {
+        world->ball_ids[i] = i;
+        world->ball_index[i] = i;
+    }
+
+    return true;
+}
+
+size_t
+World_ObstaclesSize(const char *level)
+// arena space World_InitObstacles needs
+{
+    return Obstacles_Size(4 + (level ? Obstacles_Count(level) : 0));
+}
+
+bool
+World_InitObstacles(World *world,
+                    Arena *arena,
+                    const char *level)
+// Walls around the edges of the world, unless it wraps, and the obstacles in
+// the level file if there is one.
+{
+    Obstacles *obstacles = &world->obstacles;
+    uint32_t capacity = 4 + (level ? Obstacles_Count(level) : 0);
+    float w = world->width;
+    float h = world->height;
+    float wall = WORLD_WALL_SIZE;
+
+    if (!Obstacles_Init(obstacles, arena, capacity)) return false;
+
+    if (!world->wrap) {
+        Obstacles_AddRect(obstacles, -wall, -wall, w + wall * 2, wall);
+        Obstacles_AddRect(obstacles, -wall, h, w + wall * 2, wall);
+        Obstacles_AddRect(obstacles, -wall, 0, wall, h);
+        Obstacles_AddRect(obstacles, w, 0, wall, h);
+    }
+
+    if (level && !Obstacles_Load(obstacles, level)) return false;
+
+    Obstacles_Build(obstacles);
+    return true;
+}
+
+size_t
+World_EventsSize(uint32_t ball_count)
+// arena space World_InitEvents needs
+{
+    uint32_t contacts = ball_count * WORLD_CONTACTS_PER_BALL;
+
+    // every pair can begin and every pair from the step before can end
+    return 2 * (2 * contacts * sizeof(ContactEvent) +
+                contacts * sizeof(ContactPair)) + 64;
+}
+
+bool
+World_InitEvents(World *world,
+                 Arena *arena,
+                 uint32_t mask)
+// Turns on the events in mask. Only kept events are written but any mask
+// makes a step sort its contacts to tell them apart. The mask can be changed
+// between steps, a pair touching when it goes from 0 to something begins then.
+{
+    uint32_t capacity = world->contact_capacity;
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        world->events[i] = Arena_Alloc(arena, 2 * capacity *
+                                              sizeof(ContactEvent));
+        world->pairs[i] = Arena_Alloc(arena, capacity * sizeof(ContactPair));
+        if (!world->events[i] || !world->pairs[i]) return false;
+    }
+
+    world->event_mask = mask;
+    return true;
+}
+
+const ContactEvent *
+World_Events(const World *world,
+             uint32_t *count)
+// The events of the last step, sorted by pair.
+{
+    *count = world->event_count[world->event_buffer];
+    return world->events[world->event_buffer];
+}
+
+float
+World_Random(World *world)
+// xorshift, between 0 and 1. Every world has its own so that worlds on
+// different threads do not share rand()'s state.
+{
+    uint32_t x = world->seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    world->seed = x;
+    return x / (float)UINT32_MAX;
+}
+
+Ball *
+World_Ball(World *world,
+           uint32_t id)
+{
+    return &world->balls[world->ball_index[id]];
+}
+
+void
+World_Scatter(World *world,
+              uint32_t seed,
+              float size_min,
+              float size_max,
+              float speed,
+              uint8_t color_count)
+// Random sizes and places, heading in a random direction at speed.
+{
+    world->seed = seed ? seed : 1;
+
+    for (uint32_t i = 0; i < world->ball_count; ++i) {
+        Ball *b = &world->balls[i];
+        float direction = World_Random(world) * 2.0f * M_PI;
+
+        float radius = World_Random(world) * (size_max - size_min) + size_min;
+        b->px = World_Random(world) * world->width;
+        b->py = World_Random(world) * world->height;
+        b->vx = cosf(direction) * speed;
+        b->vy = sinf(direction) * speed;
+
+        uint8_t color = World_Random(world) * color_count;
+        if (color >= color_count) color = color_count - 1;
+        Ball_Set(b, radius, color);
+#ifndef WORLD_COMPACT
+        b->ax = 0;
+        b->ay = 0;
+        b->mass = b->radius * world->mass_factor;
+#endif
+    }
+}
+
+void
+World_Integrate(World *world,
+                float dt)
+// The first half of a substep, every ball moves on its own. World_Collide is
+// the rest. World_Step does both, they are apart for running a world in
+// pieces (slabs.c).
+{
+    float rest = world->rest_speed * world->rest_speed;
+
+    world->moving = 0;
+
+    for (uint32_t i = 0; i < world->ball_count; ++i) {
+        Ball *b = &world->balls[i];
+        // drag
+        float ax = -b->vx * world->drag;
+        float ay = -b->vy * world->drag;
+
+        b->vx += ax * dt;
+        b->vy += ay * dt;
+#ifndef WORLD_COMPACT
+        b->ax = ax;
+        b->ay = ay;
+#endif
+        b->px += b->vx * dt;
+        b->py += b->vy * dt;
+
+        if (world->wrap) {
+            b->px -= world->width * floorf(b->px / world->width);
+            b->py -= world->height * floorf(b->py / world->height);
+        }
+
+        if (b->vx * b->vx + b->vy * b->vy < rest) {
+            b->vx = 0;
+            b->vy = 0;
+        } else {
+            world->moving++;
+        }
+    }
+}
+
+static void
+delta(const World *world,
+      const Ball *b1,
+      const Ball *b2,
+      float *dx,
+      float *dy)
+// b1 - b2. When the world wraps this is the minimum image, the shortest way
+// round, so balls on opposite edges are close.
+{
+    *dx = b1->px - b2->px;
+    *dy = b1->py - b2->py;
+
+    if (!world->wrap) return;
+    *dx -= world->width * roundf(*dx / world->width);
+    *dy -= world->height * roundf(*dy / world->height);
+}
+
+static uint32_t
+spread(uint32_t x)
+// puts a 0 bit between each of the low 16 bits
+{
+    x &= 0xFFFF;
+    x = (x | x << 8) & 0x00FF00FF;
+    x = (x | x << 4) & 0x0F0F0F0F;
+    x = (x | x << 2) & 0x33333333;
+    x = (x | x << 1) & 0x55555555;
+    return x;
+}
+
+static uint64_t
+keyAt(const uint8_t *base,
+      size_t size,
+      uint32_t i)
+{
+    uint64_t key;
+
+    memcpy(&key, base + i * size, sizeof(key));
+    return key;
+}
+
+static void
+swap(uint8_t *base,
+     size_t size,
+     uint32_t i,
+     uint32_t j)
+{
+    uint8_t t[16];
+
+    memcpy(t, base + i * size, size);
+    memcpy(base + i * size, base + j * size, size);
+    memcpy(base + j * size, t, size);
+}
+
+static void
+siftDown(uint8_t *base,
+         size_t size,
+         uint32_t root,
+         uint32_t count)
+{
+    for (;;) {
+        uint32_t child = 2 * root + 1;
+
+        if (child >= count) return;
+        if (child + 1 < count &&
+            keyAt(base, size, child + 1) > keyAt(base, size, child))
+            child++;
+        if (keyAt(base, size, root) >= keyAt(base, size, child)) return;
+
+        swap(base, size, root, child);
+        root = child;
+    }
+}
+
+static void
+sortByKey(void *data,
+          uint32_t count,
+          size_t size)
+// Heapsort on the uint64_t each element starts with, elements of at most 16
+// bytes. Not qsort, glibc's mallocs a buffer for all but small arrays and a
+// step must not allocate.
+{
+    uint8_t *base = data;
+
+    for (uint32_t root = count / 2; root-- > 0;)
+        siftDown(base, size, root, count);
+    for (uint32_t last = count; last-- > 1;) {
+        swap(base, size, 0, last);
+        siftDown(base, size, 0, last);
+    }
+}
+
+static void
+reorder(World *world)
+// Sorts the balls by the Morton key of their position, x and y cut to 16 bits
+// each and interleaved. Following the keys in order walks the world in
+// nested Zs, so sorted balls near each other in memory are near each other
+// in the world too. Ids go with their balls.
+{
+    uint32_t count = world->ball_count;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const Ball *b = &world->balls[i];
+        float x = fminf(fmaxf(b->px / world->width, 0), 1) * 0xFFFF;
+        float y = fminf(fmaxf(b->py / world->height, 0), 1) * 0xFFFF;
+        uint32_t key = spread(x) | spread(y) << 1;
+
+        world->morton[i] = (uint64_t)key << 32 | i;
+    }
+
+    sortByKey(world->morton, count, sizeof(uint64_t));
+
+    for (uint32_t i = 0; i < count; ++i)
+        world->sorted[i] = world->balls[(uint32_t)world->morton[i]];
+    memcpy(world->balls, world->sorted, count * sizeof(Ball));
+
+    // the ids in their new order go through morton, then back into ball_ids
+    for (uint32_t i = 0; i < count; ++i)
+        world->morton[i] = world->ball_ids[(uint32_t)world->morton[i]];
+    for (uint32_t i = 0; i < count; ++i) {
+        world->ball_ids[i] = world->morton[i];
+        world->ball_index[world->ball_ids[i]] = i;
+    }
+
+    world->reorders++;
+}
+
+static uint32_t
+cellOf(const World *world,
+       const Ball *b)
+// Balls outside a world that does not wrap go in the edge cells.
+{
+    int x = floorf(b->px / world->cell_w);
+    int y = floorf(b->py / world->cell_h);
+
+    if (world->wrap) {
+        x = ((x % (int)world->cells_x) + world->cells_x) % world->cells_x;
+        y = ((y % (int)world->cells_y) + world->cells_y) % world->cells_y;
+    } else {
+        x = x < 0 ? 0 : x >= (int)world->cells_x ? (int)world->cells_x - 1 : x;
+        y = y < 0 ? 0 : y >= (int)world->cells_y ? (int)world->cells_y - 1 : y;
+    }
+
+    return y * world->cells_x + x;
+}
+
+static void
+buildGrid(World *world)
+// Cells are at least as wide as the biggest ball so that touching balls are
+// always in the same or neighbouring cells. When wrapping, the cells divide
+// the world exactly so the last one meets the first.
+{
+    float biggest = 0;
+    uint32_t *start = world->cell_start;
+
+    for (uint32_t i = 0; i < world->ball_count; ++i)
+        biggest = fmaxf(biggest, Ball_Radius(&world->balls[i]));
+
+    if (world->ball_count == 0 || world->cell_capacity == 0) {
+        world->cells_x = world->cells_y = 1;
+        start[0] = 0;
+        return;
+    }
+
+    float size = fmaxf(biggest * 2,
+                       sqrtf(world->width * world->height /
+                             world->cell_capacity));
+
+    // a long thin world can still need more cells than there is room for,
+    // with one cell across, they get bigger until they fit
+    for (;;) {
+        world->cells_x = fmaxf(1, floorf(world->width / size));
+        world->cells_y = fmaxf(1, floorf(world->height / size));
+        if ((uint64_t)world->cells_x * world->cells_y <= world->cell_capacity)
+            break;
+        size *= 1.5f;
+    }
+
+    world->cell_w = world->width / world->cells_x;
+    world->cell_h = world->height / world->cells_y;
+
+    uint32_t cells = world->cells_x * world->cells_y;
+
+    memset(start, 0, (cells + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < world->ball_count; ++i) {
+        world->ball_cells[i] = cellOf(world, &world->balls[i]);
+        start[world->ball_cells[i] + 1]++;
+    }
+
+    for (uint32_t i = 0; i < cells; ++i) start[i + 1] += start[i];
+
+    // start[i] is used as the insert point and ends up at the next cell's
+    // start, shift it back after
+    for (uint32_t i = 0; i < world->ball_count; ++i)
+        world->cell_balls[start[world->ball_cells[i]]++] = i;
+    memmove(start + 1, start, cells * sizeof(uint32_t));
+    start[0] = 0;
+}
+
+static uint32_t
+neighbours(const World *world,
+           uint32_t cell,
+           uint32_t *cells)
+// The cell and the ones around it, each once. A wrapping world only a cell or
+// two across would otherwise see the same cell from both sides.
+{
+    int cx = cell % world->cells_x;
+    int cy = cell / world->cells_x;
+    int w = world->cells_x;
+    int h = world->cells_y;
+    uint32_t count = 0;
+
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            int x = cx + dx;
+            int y = cy + dy;
+
+            if (world->wrap) {
+                x = (x + w) % w;
+                y = (y + h) % h;
+            } else if (x < 0 || x >= w || y < 0 || y >= h) {
+                continue;
+            }
+
+            uint32_t n = y * w + x;
+            bool seen = false;
+            for (uint32_t i = 0; i < count; ++i) seen |= cells[i] == n;
+            if (!seen) cells[count++] = n;
+        }
+    }
+
+    return count;
+}
+
+static void
+broadphase(World *world)
+// Balls are put in a grid and only checked against balls in their own and the
+// neighbouring cells, with a box test. Pairs whose boxes overlap are
+// candidates for narrowphase.
+{
+    uint32_t cells[9];
+
+    world->candidate_count = 0;
+    buildGrid(world);
+
+    for (uint32_t i = 0; i < world->ball_count; ++i) {
+        Ball *b1 = &world->balls[i];
+        uint32_t count = neighbours(world, world->ball_cells[i], cells);
+
+        for (uint32_t n = 0; n < count; ++n) {
+            uint32_t first = world->cell_start[cells[n]];
+            uint32_t last = world->cell_start[cells[n] + 1];
+
+            for (uint32_t k = first; k < last; ++k) {
+                uint32_t j = world->cell_balls[k];
+                Ball *b2 = &world->balls[j];
+                float r = Ball_Radius(b1) + Ball_Radius(b2);
+                float dx, dy;
+
+                // every pair once
+                if (j <= i) continue;
+
+                delta(world, b1, b2, &dx, &dy);
+                if (fabsf(dx) > r || fabsf(dy) > r) continue;
+
+                if (world->candidate_count == world->candidate_capacity) {
+                    world->contacts_dropped++;
+                    continue;
+                }
+
+                world->candidates[world->candidate_count++] = (Contact) {
+                    .a = i,
+                    .b = j
+                };
+            }
+        }
+    }
+}
+
+static void
+sortContacts(World *world)
+// By ball id, lower id first in each pair and pairs in order. The order picks
+// the colours and so what the solve does, sorted it does not depend on where
+// the balls are in memory or how the grid was cut, and a world holding part
+// of the balls (slabs.c) orders the contacts it shares with the whole world
+// the same way. The candidates are done with, their room holds the keys.
+{
+    ContactPair *order = (ContactPair *)world->candidates;
+    uint32_t count = world->contact_count;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        Contact *c = &world->contacts[i];
+        uint32_t a = world->ball_ids[c->a];
+        uint32_t b = world->ball_ids[c->b];
+
+        if (a > b) {
+            uint32_t t = a;
+            a = b;
+            b = t;
+            t = c->a;
+            c->a = c->b;
+            c->b = t;
+        }
+        order[i] = (ContactPair) {.key = (uint64_t)a << 32 | b, .contact = i};
+    }
+    sortByKey(order, count, sizeof(ContactPair));
+
+    for (uint32_t i = 0; i < count; ++i)
+        world->colored[i] = world->contacts[order[i].contact];
+    memcpy(world->contacts, world->colored, count * sizeof(Contact));
+}
+
+static void
+narrowphase(World *world)
+// The candidates that really touch become contacts.
+{
+    world->contact_count = 0;
+
+    for (uint32_t i = 0; i < world->candidate_count; ++i) {
+        const Contact *c = &world->candidates[i];
+        Ball *b1 = &world->balls[c->a];
+        Ball *b2 = &world->balls[c->b];
+        float r = Ball_Radius(b1) + Ball_Radius(b2);
+        float dx, dy;
+
+        delta(world, b1, b2, &dx, &dy);
+        if (dx * dx + dy * dy > r * r) continue;
+
+        if (world->contact_count == world->contact_capacity) {
+            world->contacts_dropped++;
+            continue;
+        }
+
+        world->contacts[world->contact_count++] = *c;
+    }
+
+    world->contacts_total += world->contact_count;
+    sortContacts(world);
+}
+
+static void
+colorContacts(World *world)
+// Greedy, each contact gets the lowest colour neither of its balls is in yet.
+// A ball touches only a few others so this needs few colours. The contacts are
+// then sorted by colour, keeping their order within a colour, so the result
+// does not depend on how many threads solve them.
+{
+    uint32_t *start = world->color_start;
+    const uint32_t overflow = WORLD_COLORS - 1;
+
+    memset(world->ball_colors, 0, world->ball_count * sizeof(uint32_t));
+    memset(start, 0, sizeof(world->color_start));
+    world->color_count = 0;
+
+    for (uint32_t i = 0; i < world->contact_count; ++i) {
+        Contact *c = &world->contacts[i];
+        uint32_t open = ~(world->ball_colors[c->a] | world->ball_colors[c->b]) &
+                        ((1u << overflow) - 1);
+
+        c->color = open ? (uint32_t)__builtin_ctz(open) : overflow;
+        if (c->color != overflow) {
+            world->ball_colors[c->a] |= 1u << c->color;
+            world->ball_colors[c->b] |= 1u << c->color;
+        }
+        if (c->color >= world->color_count) world->color_count = c->color + 1;
+        start[c->color + 1]++;
+    }
+
+    for (uint32_t i = 0; i < WORLD_COLORS; ++i) start[i + 1] += start[i];
+
+    // start[i] is used as the insert point and ends up at the next colour's
+    // start, shift it back after
+    for (uint32_t i = 0; i < world->contact_count; ++i) {
+        const Contact *c = &world->contacts[i];
+        world->colored[start[c->color]++] = *c;
+    }
+    memmove(start + 1, start, WORLD_COLORS * sizeof(uint32_t));
+    start[0] = 0;
+}
+
+static void
+separate(World *world,
+         Contact *c)
+// Static resolution, push a touching pair apart so they only just touch. Both
+// balls move half of the overlap.
+{
+    Ball *b1 = &world->balls[c->a];
+    Ball *b2 = &world->balls[c->b];
+    float dx, dy;
+
+    delta(world, b1, b2, &dx, &dy);
+
+    float distance = sqrtf(dx * dx + dy * dy);
+
+    if (distance == 0) return;
+
+    float overlap = 0.5f * (distance - Ball_Radius(b1) - Ball_Radius(b2));
+
+    b1->px -= overlap * dx / distance;
+    b1->py -= overlap * dy / distance;
+    b2->px += overlap * dx / distance;
+    b2->py += overlap * dy / distance;
+}
+
+static void
+bounce(World *world,
+       Contact *c)
+// Dynamic resolution. The velocity along the tangent is kept, along the normal
+// it is a 1D collision with restitution e:
+//
+//   v1' = (m1 v1 + m2 v2 + m2 e (v2 - v1)) / (m1 + m2)
+//   v2' = (m1 v1 + m2 v2 + m1 e (v1 - v2)) / (m1 + m2)
+{
+    float e = world->restitution;
+    Ball *b1 = &world->balls[c->a];
+    Ball *b2 = &world->balls[c->b];
+    float dx, dy;
+
+    c->impulse = 0;
+    delta(world, b2, b1, &dx, &dy);
+
+    float distance = sqrtf(dx * dx + dy * dy);
+
+    if (distance == 0) return;
+
+    // normal
+    float nx = dx / distance;
+    float ny = dy / distance;
+
+    // tangent
+    float tx = -ny;
+    float ty = nx;
+
+    float dpTan1 = b1->vx * tx + b1->vy * ty;
+    float dpTan2 = b2->vx * tx + b2->vy * ty;
+
+    float dpNorm1 = b1->vx * nx + b1->vy * ny;
+    float dpNorm2 = b2->vx * nx + b2->vy * ny;
+
+    // already moving apart
+    if (dpNorm1 - dpNorm2 <= 0) return;
+
+    float mass1 = World_Mass(world, b1);
+    float mass2 = World_Mass(world, b2);
+    float momentum = mass1 * dpNorm1 + mass2 * dpNorm2;
+    float total = mass1 + mass2;
+
+    float m1 = (momentum + mass2 * e * (dpNorm2 - dpNorm1)) / total;
+    float m2 = (momentum + mass1 * e * (dpNorm1 - dpNorm2)) / total;
+
+    b1->vx = tx * dpTan1 + nx * m1;
+    b1->vy = ty * dpTan1 + ny * m1;
+    b2->vx = tx * dpTan2 + nx * m2;
+    b2->vy = ty * dpTan2 + ny * m2;
+    c->impulse = mass2 * (m2 - dpNorm2);
+}
+
+typedef void (*Resolve) (World *world, Contact *c);
+
+typedef struct _Solve {
+    World *world;
+    Resolve resolve;
+    uint32_t first, last; // contacts of the colour being solved
+} Solve;
+
+static void
+solveChunk(void *data,
+           uint32_t task,
+           uint32_t worker)
+{
+    (void)worker;
+    Solve *solve = data;
+    uint32_t first = solve->first + task * WORLD_SOLVE_CHUNK;
+    uint32_t last = first + WORLD_SOLVE_CHUNK;
+
+    if (last > solve->last) last = solve->last;
+    for (uint32_t i = first; i < last; ++i)
+        solve->resolve(solve->world, &solve->world->colored[i]);
+}
+
+static void
+solve(World *world,
+      Resolve resolve)
+// One colour after another, always in the same order. Colours with too few
+// contacts to be worth waking the pool for are done here.
+{
+    Solve solve = {.world = world, .resolve = resolve};
+
+    for (uint32_t color = 0; color < world->color_count; ++color) {
+        solve.first = world->color_start[color];
+        solve.last = world->color_start[color + 1];
+
+        uint32_t count = solve.last - solve.first;
+        uint32_t tasks = (count + WORLD_SOLVE_CHUNK - 1) / WORLD_SOLVE_CHUNK;
+
+        if (world->pool && tasks > 1 && color != WORLD_COLORS - 1)
+            Pool_Run(world->pool, tasks, solveChunk, &solve);
+        else
+            for (uint32_t task = 0; task < tasks; ++task)
+                solveChunk(&solve, task, 0);
+    }
+}
+
+static void
+collideObstacles(World *world)
+// Last, so that balls pushed apart from each other do not end up in a wall.
+{
+    if (world->obstacles.count == 0) return;
+
+    for (uint32_t i = 0; i < world->ball_count; ++i) {
+        Ball *b = &world->balls[i];
+        world->obstacle_contacts +=
+            Obstacles_Collide(&world->obstacles, &b->px, &b->py, &b->vx,
+                              &b->vy, Ball_Radius(b), world->restitution);
+    }
+}
+
+static void
+addEvent(World *world,
+         uint32_t buffer,
+         uint32_t type,
+         uint64_t key,
+         float impulse)
+{
+    if (!(world->event_mask & type)) return;
+
+    uint32_t a = key >> 32;
+    uint32_t b = (uint32_t)key;
+    float dx, dy;
+
+    delta(world, World_Ball(world, b), World_Ball(world, a), &dx, &dy);
+
+    float distance = sqrtf(dx * dx + dy * dy);
+    if (distance == 0) distance = INFINITY;
+
+    world->events[buffer][world->event_count[buffer]++] = (ContactEvent) {
+        .type = type,
+        .a = a,
+        .b = b,
+        .impulse = impulse,
+        .nx = dx / distance,
+        .ny = dy / distance,
+    };
+}
+
+static void
+contactEvents(World *world)
+// The pairs touching now are sorted and walked alongside the ones from the
+// step before. In both it persists, only now it begins, only before it ends.
+{
+    uint32_t last = world->event_buffer;
+    uint32_t next = last ^ 1;
+
+    if (!world->event_mask) {
+        // nothing was touching as far as the next events go
+        world->event_count[last] = 0;
+        world->pair_count[last] = 0;
+        return;
+    }
+
+    const ContactPair *before = world->pairs[last];
+    ContactPair *now = world->pairs[next];
+    uint32_t before_count = world->pair_count[last];
+    uint32_t now_count = world->contact_count;
+
+    // by id, so pairs are still the same pairs after the balls are sorted
+    for (uint32_t i = 0; i < now_count; ++i) {
+        const Contact *c = &world->colored[i];
+        uint32_t a = world->ball_ids[c->a];
+        uint32_t b = world->ball_ids[c->b];
+
+        now[i] = (ContactPair) {
+            .key = a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a,
+            .contact = i,
+        };
+    }
+    sortByKey(now, now_count, sizeof(ContactPair));
+
+    world->event_count[next] = 0;
+    uint32_t i = 0, j = 0;
+    while (i < now_count || j < before_count) {
+        if (j == before_count ||
+            (i < now_count && now[i].key < before[j].key)) {
+            addEvent(world, next, WORLD_EVENT_BEGIN, now[i].key,
+                     world->colored[now[i].contact].impulse);
+            i++;
+        } else if (i == now_count || before[j].key < now[i].key) {
+            addEvent(world, next, WORLD_EVENT_END, before[j].key, 0);
+            j++;
+        } else {
+            addEvent(world, next, WORLD_EVENT_PERSIST, now[i].key,
+                     world->colored[now[i].contact].impulse);
+            i++;
+            j++;
+        }
+    }
+
+    world->pair_count[next] = now_count;
+    world->event_buffer = next;
+}
+
+static void
+phaseDone(World *world,
+          uint32_t phase)
+{
+    if (world->perf) Perf_End(world->perf, phase, world->ball_count);
+}
+
+uint32_t
+World_Substeps(const World *world,
+               float fastest,
+               float smallest,
+               float dt)
+// Fewest substeps for which a ball at the fastest speed moves at most cfl
+// times the smallest radius in each.
+{
+    float distance = fastest * fabsf(dt);
+    float limit = world->cfl * smallest;
+
+    if (world->cfl <= 0) return 1;
+
+    if (distance <= limit || limit <= 0) return 1;
+
+    float count = ceilf(distance / limit);
+    return count > WORLD_MAX_SUBSTEPS ? WORLD_MAX_SUBSTEPS : count;
+}
+
+static uint32_t
+substeps(const World *world,
+         float dt)
+{
+    float fastest = 0;
+    float smallest = INFINITY;
+
+    for (uint32_t i = 0; i < world->ball_count; ++i) {
+        const Ball *b = &world->balls[i];
+        fastest = fmaxf(fastest, b->vx * b->vx + b->vy * b->vy);
+        smallest = fminf(smallest, Ball_Radius(b));
+    }
+
+    return World_Substeps(world, sqrtf(fastest), smallest, dt);
+}
+
+static uint64_t
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void
+World_Collide(World *world)
+// The second half of a substep, finds the touching pairs and resolves them,
+// then the obstacles.
+{
+    uint64_t start = now();
+    broadphase(world);
+    phaseDone(world, WORLD_BROADPHASE);
+    narrowphase(world);
+    phaseDone(world, WORLD_NARROWPHASE);
+    world->collide_ns += now() - start;
+
+    colorContacts(world);
+    start = now();
+    solve(world, separate);
+    solve(world, bounce);
+    world->solve_ns += now() - start;
+
+    collideObstacles(world);
+    phaseDone(world, WORLD_RESOLVE);
+}
+
+static void
+substep(World *world,
+        float dt)
+{
+    if (world->perf) Perf_Begin(world->perf);
+
+    World_Integrate(world, dt);
+    phaseDone(world, WORLD_INTEGRATE);
+    World_Collide(world);
+}
+
+void
+World_Step(World *world,
+           float dt)
+// Quiet steps are done in one go. Contact events compare the contacts after
+// the last substep with the ones after the last step.
+{
+    uint32_t count = substeps(world, dt);
+
+    if (world->reorder_every && world->steps % world->reorder_every == 0) {
+        if (world->perf) Perf_Begin(world->perf);
+        reorder(world);
+        phaseDone(world, WORLD_REORDER);
+    }
+
+    for (uint32_t i = 0; i < count; ++i) substep(world, dt / count);
+
+    world->substeps = count;
+    if (count > world->substeps_max) world->substeps_max = count;
+    world->substeps_total += count;
+    contactEvents(world);
+    world->steps++;
+}
+
+double
+World_Energy(const World *world)
+// kinetic energy of all the balls
+{
+    double energy = 0;
+
+    for (uint32_t i = 0; i < world->ball_count; ++i) {
+        const Ball *b = &world->balls[i];
+        energy += 0.5 * World_Mass(world, b) *
+                  (b->vx * b->vx + b->vy * b->vy);
+    }
+
+    return energy;
+}
@@ -0,0 +1,241 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+#include "obstacles.h"
+#include "pool.h"
+#include "perf.h"
+
+// The ball physics without any SDL, so that it can run without a window (batch
+// runs) and the game only has to draw it. All the memory a world needs comes
+// out of an arena when it is made, stepping does not allocate.
+
+// Contacts a world has room for, per ball. Balls that do not overlap touch as
+// a planar graph, fewer than 3 contacts per ball. Even balls scattered at
+// random over twice the world's area stay under 4.
+#define WORLD_CONTACTS_PER_BALL 4
+// pairs whose boxes overlap, some of them will not be touching
+#define WORLD_CANDIDATES_PER_BALL 8
+// how thick the walls around the world are, thick enough that a fast ball
+// cannot get through in one step
+#define WORLD_WALL_SIZE 200.0f
+// Contacts are coloured so that no two in a colour share a ball, then each
+// colour is solved in parallel. Contacts that find no free colour go in the
+// last one, which is solved on one thread.
+#define WORLD_COLORS 32
+// contacts per pool task
+#define WORLD_SOLVE_CHUNK 64
+// broadphase grid cells a world has room for, per ball
+#define WORLD_CELLS_PER_BALL 2
+// most substeps a step is split into, however fast the balls are
+#define WORLD_MAX_SUBSTEPS 32
+
+// the parts of a step, for Perf
+enum {WORLD_REORDER, WORLD_INTEGRATE, WORLD_BROADPHASE, WORLD_NARROWPHASE,
+      WORLD_RESOLVE, WORLD_PHASES};
+
+#ifdef WORLD_COMPACT
+
+// 20 bytes instead of 36, for worlds of millions of balls where stepping is
+// mostly waiting on memory (make COMPACT=1). Acceleration is worked out where
+// it is needed and mass is radius times the world's mass_factor. The radius
+// is a float with the low 8 bits of its mantissa cut off, about 5 digits, and
+// the colour goes in their place.
+typedef struct _Ball {
+    float px, py, vx, vy;
+    uint32_t shape; // radius and colour, use Ball_Radius and Ball_Color
+} Ball;
+
+static inline float
+Ball_Radius(const Ball *b)
+{
+    uint32_t bits = b->shape & ~0xFFu;
+    float radius;
+
+    memcpy(&radius, &bits, sizeof(radius));
+    return radius;
+}
+
+static inline uint8_t
+Ball_Color(const Ball *b)
+{
+    return b->shape & 0xFF;
+}
+
+static inline void
+Ball_Set(Ball *b,
+         float radius,
+         uint8_t color)
+// the radius is rounded to the nearest that fits
+{
+    uint32_t bits;
+
+    memcpy(&bits, &radius, sizeof(bits));
+    b->shape = ((bits + 0x80) & ~0xFFu) | color;
+}
+
+#else
+
+typedef struct _Ball {
+    float px, py, vx, vy, ax, ay;
+    float radius;
+    uint8_t color;
+    float mass;
+} Ball;
+
+static inline float
+Ball_Radius(const Ball *b)
+{
+    return b->radius;
+}
+
+static inline uint8_t
+Ball_Color(const Ball *b)
+{
+    return b->color;
+}
+
+static inline void
+Ball_Set(Ball *b,
+         float radius,
+         uint8_t color)
+// mass is set by World_Scatter
+{
+    b->radius = radius;
+    b->color = color;
+}
+
+#endif
+
+typedef struct _Contact {
+    uint32_t a, b; // indices into balls
+    uint32_t color;
+    float impulse; // along the normal, from the last bounce
+} Contact;
+
+// What happened to a pair of balls in a step. The types are bits so that a
+// mask can pick which ones are kept.
+enum {WORLD_EVENT_BEGIN = 1, WORLD_EVENT_PERSIST = 2, WORLD_EVENT_END = 4};
+
+typedef struct _ContactEvent {
+    uint32_t type; // one WORLD_EVENT_ bit
+    uint32_t a, b; // a < b, ball ids
+    float impulse; // given to b and taken from a, 0 for an end
+    float nx, ny; // unit normal from a to b after the step
+} ContactEvent;
+
+typedef struct _ContactPair {
+    uint64_t key; // ids, a << 32 | b, sorts by a then b
+    uint32_t contact; // index of the contact, this step only
+} ContactPair;
+
+typedef struct _World {
+    Ball *balls;
+    uint32_t ball_count;
+    // Balls move in memory when they are sorted, a ball's id stays the same.
+    // ball_ids[i] is the id of balls[i] and ball_index[id] is where it is.
+    uint32_t *ball_ids;
+    uint32_t *ball_index;
+    // Every this many steps the balls are sorted along a Z-order (Morton)
+    // curve, so balls close together in the world are close in memory and
+    // the grid walks less of it. 0 never sorts.
+    uint32_t reorder_every;
+    uint64_t *morton; // key << 32 | index, for sorting
+    Ball *sorted; // the balls in their new order, copied back
+    Contact *contacts; // touching pairs found in the last step
+    uint32_t contact_count;
+    uint32_t contact_capacity;
+    Contact *candidates; // pairs the broadphase found, checked by narrowphase
+    uint32_t candidate_count;
+    uint32_t candidate_capacity;
+
+    // Broadphase grid, cells at least as wide as the biggest ball. Balls are
+    // sorted by cell, cell i has cell_balls[cell_start[i]] up to
+    // cell_balls[cell_start[i + 1]].
+    uint32_t *cell_start;
+    uint32_t *cell_balls;
+    uint32_t *ball_cells; // the cell of each ball
+    uint32_t cells_x, cells_y;
+    float cell_w, cell_h;
+    uint32_t cell_capacity;
+    Contact *colored; // the contacts again, sorted by colour
+    uint32_t color_start[WORLD_COLORS + 1]; // first contact of each colour
+    uint32_t color_count; // colours used in the last step
+    uint32_t *ball_colors; // colours each ball is in, one bit each
+    Pool *pool; // solves the contacts if set, can be shared between worlds
+    Perf *perf; // counts every phase of a step if set
+    Obstacles obstacles; // set up with Obstacles_Init, empty by default
+
+    // Contact events, off until World_InitEvents. A step writes one buffer
+    // while the other still holds the step before, so what World_Events
+    // returns can still be read while the next step runs.
+    uint32_t event_mask; // WORLD_EVENT_ bits to keep
+    ContactEvent *events[2];
+    uint32_t event_count[2];
+    ContactPair *pairs[2]; // pairs touching after each step, sorted
+    uint32_t pair_count[2];
+    uint32_t event_buffer; // the one the last step wrote
+
+    float width, height;
+    // Leaving one side comes back in on the other and balls touch across the
+    // edges, no walls. Set before World_InitObstacles.
+    bool wrap;
+    float drag; // fraction of the velocity lost per second
+    float mass_factor; // mass is radius times this
+    float restitution; // 1 is perfectly elastic
+    float rest_speed; // slower than this and a ball is stopped
+    // A step is split into the fewest substeps that keep every ball moving
+    // less than this fraction of the smallest radius in each, so one fast ball
+    // does not go through another. 0 always takes one.
+    float cfl;
+
+    uint32_t moving; // balls with a velocity after the last step
+    uint64_t steps;
+    uint32_t substeps; // in the last step
+    uint32_t substeps_max;
+    uint64_t substeps_total;
+    uint64_t contacts_total; // contacts summed over all steps
+    uint64_t contacts_dropped; // contacts or candidates that did not fit
+    uint64_t obstacle_contacts; // ball against obstacle, over all steps
+    uint64_t solve_ns; // time spent solving contacts, over all steps
+    uint64_t collide_ns; // time spent in broadphase and narrowphase
+    uint64_t reorders;
+    uint32_t seed; // for World_Scatter
+} World;
+
+static inline float
+World_Mass(const World *world,
+           const Ball *b)
+{
+#ifdef WORLD_COMPACT
+    return Ball_Radius(b) * world->mass_factor;
+#else
+    (void)world;
+    return b->mass;
+#endif
+}
+
+size_t World_Size(uint32_t ball_count);
+bool World_Init(World *world, Arena *arena, uint32_t ball_count, float width,
+                float height);
+size_t World_ObstaclesSize(const char *level);
+bool World_InitObstacles(World *world, Arena *arena, const char *level);
+size_t World_EventsSize(uint32_t ball_count);
+bool World_InitEvents(World *world, Arena *arena, uint32_t mask);
+const ContactEvent *World_Events(const World *world, uint32_t *count);
+void World_Scatter(World *world, uint32_t seed, float size_min,
+                   float size_max, float speed, uint8_t color_count);
+void World_Step(World *world, float dt);
+uint32_t World_Substeps(const World *world, float fastest, float smallest,
+                        float dt);
+void World_Integrate(World *world, float dt);
+void World_Collide(World *world);
+double World_Energy(const World *world);
+float World_Random(World *world);
+Ball *World_Ball(World *world, uint32_t id);
+
+#endif
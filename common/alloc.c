@@ -0,0 +1,190 @@
+#ifdef ALLOC_TRACK
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "alloc.h"
+
+// glibc's own, what the replacements pass on to
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *p);
+
+typedef struct _AllocPhase {
+    const char *name;
+    atomic_ulong allocs;
+    atomic_ulong frees;
+    atomic_ulong bytes;
+} AllocPhase;
+
+// Plain globals, malloc has nowhere else to find them. The last phase is
+// everything outside the named ones, startup included.
+static AllocPhase phases[ALLOC_MAX_PHASES + 1];
+static uint32_t phase_count;
+// each thread's own, so the telemetry, export and pool threads stay in
+// ALLOC_NONE whatever phase the game loop is in
+static _Thread_local uint32_t current = ALLOC_NONE;
+static uint32_t strict; // phase bits
+static atomic_bool armed; // warm up is over
+
+static atomic_ulong frame_allocs;
+static uint64_t frames;
+static uint64_t frames_allocating;
+static uint64_t frame_max;
+
+static void
+counted(size_t size)
+{
+    uint32_t phase = current;
+    AllocPhase *p = &phases[phase];
+
+    atomic_fetch_add_explicit(&p->allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&p->bytes, size, memory_order_relaxed);
+    atomic_fetch_add_explicit(&frame_allocs, 1, memory_order_relaxed);
+
+    if (phase == ALLOC_NONE || !(strict & 1u << phase) ||
+        !atomic_load_explicit(&armed, memory_order_relaxed))
+        return;
+
+    // fprintf can allocate, snprintf onto the stack does not
+    char message[128];
+    int length = snprintf(message, sizeof(message),
+                          "alloc: %zu bytes in %s after warm up\n", size,
+                          p->name ? p->name : "?");
+    write(STDERR_FILENO, message, length);
+    abort();
+}
+
+void *
+malloc(size_t size)
+{
+    counted(size);
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t count,
+       size_t size)
+{
+    // glibc fails an overflowing calloc, nothing is allocated
+    counted(size && count > SIZE_MAX / size ? 0 : count * size);
+    return __libc_calloc(count, size);
+}
+
+void *
+realloc(void *p,
+        size_t size)
+// freeing with realloc is still counted as an allocation
+{
+    counted(size);
+    return __libc_realloc(p, size);
+}
+
+void *
+memalign(size_t alignment,
+         size_t size)
+{
+    counted(size);
+    return __libc_memalign(alignment, size);
+}
+
+void *
+aligned_alloc(size_t alignment,
+              size_t size)
+{
+    counted(size);
+    return __libc_memalign(alignment, size);
+}
+
+int
+posix_memalign(void **p,
+               size_t alignment,
+               size_t size)
+{
+    // a power of two multiple of sizeof(void *), as glibc checks it
+    if (alignment % sizeof(void *) || alignment & (alignment - 1) ||
+        alignment == 0)
+        return EINVAL;
+
+    counted(size);
+    void *q = __libc_memalign(alignment, size);
+    if (!q) return ENOMEM;
+    *p = q;
+    return 0;
+}
+
+void
+free(void *p)
+{
+    if (!p) return;
+
+    uint32_t phase = current;
+    atomic_fetch_add_explicit(&phases[phase].frees, 1, memory_order_relaxed);
+    __libc_free(p);
+}
+
+void
+Alloc_Init(const char *const *names,
+           uint32_t count,
+           uint32_t strict_phases)
+{
+    if (count > ALLOC_MAX_PHASES) count = ALLOC_MAX_PHASES;
+    phase_count = count;
+    for (uint32_t i = 0; i < count; ++i) phases[i].name = names[i];
+    phases[ALLOC_NONE].name = "other";
+    strict = strict_phases;
+}
+
+void
+Alloc_Phase(uint32_t phase)
+// Where allocations on the calling thread are counted from now on.
+{
+    if (phase > ALLOC_NONE) phase = ALLOC_NONE;
+    current = phase;
+}
+
+void
+Alloc_Frame(void)
+// Call once at the end of every frame.
+{
+    uint64_t allocs = atomic_exchange(&frame_allocs, 0);
+
+    frames++;
+    if (allocs > 0) frames_allocating++;
+    if (allocs > frame_max) frame_max = allocs;
+    if (frames == ALLOC_WARMUP) atomic_store(&armed, true);
+}
+
+void
+Alloc_Print(FILE *out,
+            const char *name)
+{
+    // printing may allocate, count it as outside the phases
+    Alloc_Phase(ALLOC_NONE);
+
+    fprintf(out, "%s: %lu frames, %lu allocated, at most %lu allocations in "
+            "one\n", name, (unsigned long)frames,
+            (unsigned long)frames_allocating, (unsigned long)frame_max);
+    fprintf(out, "%s: %-12s %10s %10s %12s %12s\n", name, "phase", "allocs",
+            "frees", "bytes", "allocs/frame");
+
+    for (uint32_t i = 0; i <= ALLOC_NONE; ++i) {
+        const AllocPhase *p = &phases[i];
+        unsigned long allocs = atomic_load(&p->allocs);
+
+        if (i < ALLOC_NONE && i >= phase_count) continue;
+
+        fprintf(out, "%s: %-12s %10lu %10lu %12lu %12.3f\n", name,
+                p->name, allocs, (unsigned long)atomic_load(&p->frees),
+                (unsigned long)atomic_load(&p->bytes),
+                frames ? allocs / (double)frames : 0);
+    }
+}
+
+#endif
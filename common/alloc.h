@@ -0,0 +1,67 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Counts malloc, calloc, realloc, the aligned ones (memalign, aligned_alloc,
+// posix_memalign) and free in each named phase of a frame, to catch
+// allocations creeping into the frame loop. Only in builds with ALLOC_TRACK
+// defined (make ALLOC=1), where they are replaced for the whole program, SDL
+// and the drivers included, and passed on to glibc. In other builds every call
+// here is empty.
+//
+// The phase belongs to the thread that sets it. Allocations on other threads
+// (telemetry, the export writer, pool workers) are counted as outside the
+// phases and never abort.
+//
+// Phases in the strict mask abort the program on any allocation once the
+// first ALLOC_WARMUP frames are over, saying which phase and how many bytes.
+// Run it in a debugger to see where from.
+
+#define ALLOC_MAX_PHASES 8
+#define ALLOC_NONE ALLOC_MAX_PHASES // not in any phase
+#define ALLOC_WARMUP 120 // frames
+
+#ifdef ALLOC_TRACK
+
+void Alloc_Init(const char *const *names, uint32_t count, uint32_t strict);
+void Alloc_Phase(uint32_t phase);
+void Alloc_Frame(void);
+void Alloc_Print(FILE *out, const char *name);
+
+#else
+
+static inline void
+Alloc_Init(const char *const *names,
+           uint32_t count,
+           uint32_t strict)
+{
+    (void)names;
+    (void)count;
+    (void)strict;
+}
+
+static inline void
+Alloc_Phase(uint32_t phase)
+{
+    (void)phase;
+}
+
+static inline void
+Alloc_Frame(void)
+{
+}
+
+static inline void
+Alloc_Print(FILE *out,
+            const char *name)
+{
+    (void)out;
+    (void)name;
+}
+
+#endif
+
+#endif
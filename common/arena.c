@@ -0,0 +1,47 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+// every allocation starts on a cache line
+#define ARENA_ALIGN 64
+
+bool
+Arena_Init(Arena *arena,
+           size_t size)
+{
+    // aligned_alloc wants the size to be a multiple of the alignment
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    arena->memory = aligned_alloc(ARENA_ALIGN, size);
+    arena->size = arena->memory ? size : 0;
+    arena->used = 0;
+    return arena->memory != NULL;
+}
+
+void *
+Arena_Alloc(Arena *arena,
+            size_t size)
+// Zeroed memory, or NULL when the arena is full.
+{
+    size_t start = (arena->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    if (start + size > arena->size) return NULL;
+    arena->used = start + size;
+    memset(arena->memory + start, 0, size);
+    return arena->memory + start;
+}
+
+void
+Arena_Reset(Arena *arena)
+{
+    arena->used = 0;
+}
+
+void
+Arena_Free(Arena *arena)
+{
+    free(arena->memory);
+    arena->memory = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
@@ -0,0 +1,23 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A block of memory handed out front to back and freed all at once. Anything
+// that lives as long as one world (balls, contacts) comes from here so that
+// stepping never calls malloc.
+
+typedef struct _Arena {
+    uint8_t *memory;
+    size_t size;
+    size_t used;
+} Arena;
+
+bool Arena_Init(Arena *arena, size_t size);
+void *Arena_Alloc(Arena *arena, size_t size);
+void Arena_Reset(Arena *arena);
+void Arena_Free(Arena *arena);
+
+#endif
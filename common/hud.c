@@ -0,0 +1,179 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "hud.h"
+
+#define ATLAS_COLUMNS 16
+
+bool
+Hud_Init(Hud *hud,
+         SDL_Renderer *renderer,
+         const char *path,
+         int size)
+// Renders the atlas. Prints why and leaves the HUD off if the font can not be
+// loaded.
+{
+    SDL_Surface *glyphs[HUD_GLYPHS] = {0};
+    SDL_Surface *atlas = NULL;
+    SDL_Color white = {.r = 255, .g = 255, .b = 255, .a = 255};
+    int cell_w = 0, cell_h;
+
+    *hud = (Hud) {
+        .color = white,
+        .frequency = SDL_GetPerformanceFrequency(),
+    };
+
+    TTF_Font *font = TTF_OpenFont(path, size);
+    if (!font) {
+        fprintf(stderr, "hud: could not open %s, %s\n", path, TTF_GetError());
+        return false;
+    }
+
+    hud->line_height = TTF_FontLineSkip(font);
+    cell_h = TTF_FontHeight(font);
+
+    for (int i = 0; i < HUD_GLYPHS; ++i) {
+        int advance = 0;
+
+        TTF_GlyphMetrics(font, HUD_FIRST + i, NULL, NULL, NULL, NULL,
+                         &advance);
+        hud->glyphs[i].advance = advance;
+        // a space has nothing to draw
+        if (HUD_FIRST + i == ' ') continue;
+
+        glyphs[i] = TTF_RenderGlyph_Blended(font, HUD_FIRST + i, white);
+        if (glyphs[i] && glyphs[i]->w > cell_w) cell_w = glyphs[i]->w;
+    }
+
+    int rows = (HUD_GLYPHS + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS;
+    atlas = SDL_CreateRGBSurfaceWithFormat(0, cell_w * ATLAS_COLUMNS,
+                                           cell_h * rows, 32,
+                                           SDL_PIXELFORMAT_RGBA32);
+
+    for (int i = 0; atlas && i < HUD_GLYPHS; ++i) {
+        if (!glyphs[i]) continue;
+
+        SDL_Rect *rect = &hud->glyphs[i].rect;
+        *rect = (SDL_Rect) {
+            .x = (i % ATLAS_COLUMNS) * cell_w,
+            .y = (i / ATLAS_COLUMNS) * cell_h,
+            .w = glyphs[i]->w,
+            .h = glyphs[i]->h,
+        };
+        // copy the coverage as it is instead of blending it onto nothing
+        SDL_SetSurfaceBlendMode(glyphs[i], SDL_BLENDMODE_NONE);
+        SDL_BlitSurface(glyphs[i], NULL, atlas, rect);
+    }
+
+    if (atlas) {
+        hud->atlas = SDL_CreateTextureFromSurface(renderer, atlas);
+        hud->atlas_w = atlas->w;
+        hud->atlas_h = atlas->h;
+    }
+    if (hud->atlas) SDL_SetTextureBlendMode(hud->atlas, SDL_BLENDMODE_BLEND);
+    else fprintf(stderr, "hud: could not make the atlas, %s\n",
+                 SDL_GetError());
+
+    for (int i = 0; i < HUD_GLYPHS; ++i)
+        if (glyphs[i]) SDL_FreeSurface(glyphs[i]);
+    SDL_FreeSurface(atlas);
+    TTF_CloseFont(font);
+
+    return hud->atlas != NULL;
+}
+
+void
+Hud_Free(Hud *hud)
+{
+    if (hud->atlas) SDL_DestroyTexture(hud->atlas);
+    hud->atlas = NULL;
+}
+
+void
+Hud_Begin(Hud *hud)
+// Call once a frame, before printing. Throws away last frame's text and
+// counts the frame.
+{
+    uint64_t now = SDL_GetPerformanceCounter();
+
+    hud->quad_count = 0;
+    if (hud->last) {
+        double fps = (double)hud->frequency / (double)(now - hud->last);
+        // a moving average over roughly the last 30 frames
+        hud->fps = hud->fps ? hud->fps + (fps - hud->fps) / 30 : fps;
+    }
+    hud->last = now;
+}
+
+static void
+addQuad(Hud *hud,
+        const SDL_Rect *src,
+        float x,
+        float y)
+{
+    if (hud->quad_count >= HUD_QUADS) return;
+
+    float w = hud->atlas_w, h = hud->atlas_h;
+    float u0 = src->x / w, u1 = (src->x + src->w) / w;
+    float v0 = src->y / h, v1 = (src->y + src->h) / h;
+    SDL_Vertex *v = &hud->vertices[hud->quad_count * 4];
+    int *index = &hud->indices[hud->quad_count * 6];
+    int first = hud->quad_count * 4;
+
+    v[0] = (SDL_Vertex) {{x, y}, hud->color, {u0, v0}};
+    v[1] = (SDL_Vertex) {{x + src->w, y}, hud->color, {u1, v0}};
+    v[2] = (SDL_Vertex) {{x + src->w, y + src->h}, hud->color, {u1, v1}};
+    v[3] = (SDL_Vertex) {{x, y + src->h}, hud->color, {u0, v1}};
+
+    // two triangles
+    index[0] = first;
+    index[1] = first + 1;
+    index[2] = first + 2;
+    index[3] = first;
+    index[4] = first + 2;
+    index[5] = first + 3;
+
+    hud->quad_count++;
+}
+
+int
+Hud_Print(Hud *hud,
+          int x,
+          int y,
+          const char *format,
+          ...)
+// Adds a line of text with its top left at x, y. Characters outside the atlas
+// are skipped. Returns the y of the next line.
+{
+    char text[256];
+    va_list args;
+
+    if (!hud->atlas) return y;
+
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    float pen = x;
+    for (const char *c = text; *c; ++c) {
+        if (*c < HUD_FIRST || *c > HUD_LAST) continue;
+
+        const Glyph *glyph = &hud->glyphs[*c - HUD_FIRST];
+        if (glyph->rect.w > 0) addQuad(hud, &glyph->rect, pen, y);
+        pen += glyph->advance;
+    }
+
+    return y + hud->line_height;
+}
+
+void
+Hud_Draw(Hud *hud,
+         SDL_Renderer *renderer)
+// Everything printed since Hud_Begin, in one draw call.
+{
+    if (!hud->atlas || hud->quad_count == 0) return;
+
+    SDL_RenderGeometry(renderer, hud->atlas, hud->vertices,
+                       hud->quad_count * 4, hud->indices,
+                       hud->quad_count * 6);
+}
@@ -0,0 +1,54 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// A few lines of stats drawn over the game. Every printable ASCII glyph is
+// rendered once by SDL_ttf into an atlas texture when the HUD starts, after
+// that a line of text is only quads pointing into the atlas and the whole HUD
+// goes to the renderer in a single SDL_RenderGeometry call. Nothing is
+// rendered or allocated per frame.
+//
+// The font comes from BALLS_FONT, or HUD_FONT when that is not set. With no
+// font the HUD is off and every call does nothing.
+
+#define HUD_FONT "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf"
+#define HUD_FONT_SIZE 14
+#define HUD_FIRST ' '
+#define HUD_LAST '~'
+#define HUD_GLYPHS (HUD_LAST - HUD_FIRST + 1)
+#define HUD_QUADS 512 // characters per frame
+
+typedef struct _Glyph {
+    SDL_Rect rect; // where it is in the atlas
+    int advance;
+} Glyph;
+
+typedef struct _Hud {
+    SDL_Texture *atlas; // NULL when off
+    int atlas_w, atlas_h;
+    Glyph glyphs[HUD_GLYPHS];
+    int line_height;
+    SDL_Color color;
+
+    SDL_Vertex vertices[HUD_QUADS * 4];
+    int indices[HUD_QUADS * 6];
+    uint32_t quad_count;
+
+    // frame rate, smoothed so it can be read
+    uint64_t frequency;
+    uint64_t last;
+    double fps;
+} Hud;
+
+bool Hud_Init(Hud *hud, SDL_Renderer *renderer, const char *path, int size);
+void Hud_Free(Hud *hud);
+void Hud_Begin(Hud *hud);
+int Hud_Print(Hud *hud, int x, int y, const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
+void Hud_Draw(Hud *hud, SDL_Renderer *renderer);
+
+#endif
@@ -0,0 +1,88 @@
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "pacer.h"
+
+void
+Pacer_Init(Pacer *pacer,
+           uint32_t fps,
+           bool vsync)
+{
+    memset(pacer, 0, sizeof(Pacer));
+    pacer->frequency = SDL_GetPerformanceFrequency();
+    pacer->period = pacer->frequency / fps;
+    pacer->vsync = vsync;
+    pacer->last = SDL_GetPerformanceCounter();
+    pacer->next = pacer->last + pacer->period;
+    pacer->seconds = 1.0f / fps;
+}
+
+static void
+record(Pacer *pacer,
+       uint64_t now)
+{
+    double ms = (double)(now - pacer->last) * 1000.0 / pacer->frequency;
+    double delta = ms - pacer->mean;
+
+    pacer->last = now;
+    pacer->seconds = fminf(ms / 1000.0, PACER_MAX_SECONDS);
+    pacer->frames++;
+    pacer->mean += delta / pacer->frames;
+    pacer->m2 += delta * (ms - pacer->mean);
+
+    if (pacer->frames == 1 || ms < pacer->min) pacer->min = ms;
+    if (ms > pacer->max) pacer->max = ms;
+}
+
+void
+Pacer_Wait(Pacer *pacer)
+// Call once per frame, after SDL_RenderPresent. Returns at the start of the
+// next frame.
+{
+    uint64_t now = SDL_GetPerformanceCounter();
+
+    if (pacer->vsync) {
+        record(pacer, now);
+        return;
+    }
+
+    if (now >= pacer->next) {
+        // Overran. Start the next frame from now instead of trying to catch
+        // up, catching up would just run a burst of short frames.
+        pacer->late++;
+        pacer->next = now + pacer->period;
+        record(pacer, now);
+        return;
+    }
+
+    uint64_t spin = pacer->frequency * PACER_SPIN_MS / 1000;
+    uint64_t left = pacer->next - now;
+
+    if (left > spin) SDL_Delay((left - spin) * 1000 / pacer->frequency);
+
+    do {
+        now = SDL_GetPerformanceCounter();
+    } while (now < pacer->next);
+
+    pacer->next += pacer->period;
+    record(pacer, now);
+}
+
+double
+Pacer_Jitter(const Pacer *pacer)
+// standard deviation of the frame time in milliseconds
+{
+    if (pacer->frames < 2) return 0;
+    return sqrt(pacer->m2 / (pacer->frames - 1));
+}
+
+void
+Pacer_Print(const Pacer *pacer,
+            const char *name)
+{
+    printf("%s: %lu frames, %lu late, frame time %.3f ms "
+           "(min %.3f, max %.3f, jitter %.3f)\n",
+           name, (unsigned long)pacer->frames, (unsigned long)pacer->late,
+           pacer->mean, pacer->min, pacer->max, Pacer_Jitter(pacer));
+}
@@ -0,0 +1,42 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Keeps the game loop at a steady frame rate. SDL_Delay only has millisecond
+// resolution and usually oversleeps, so the pacer sleeps for most of the time
+// that is left and then spins on SDL_GetPerformanceCounter for the rest. With
+// vsync on, SDL_RenderPresent already waits for the display and the pacer only
+// measures.
+
+// time left before the deadline that is spun instead of slept
+#define PACER_SPIN_MS 1
+
+// longest frame the game steps by, a stall (dragging the window, a
+// debugger) is stepped as this instead of all at once
+#define PACER_MAX_SECONDS 0.1f
+
+typedef struct _Pacer {
+    uint64_t frequency; // performance counter ticks per second
+    uint64_t period; // ticks per frame
+    uint64_t next; // deadline of the current frame
+    uint64_t last; // when the last frame ended
+    float seconds; // how long the last frame took, the period before any
+    bool vsync;
+
+    // frame time stats, in milliseconds
+    uint64_t frames;
+    uint64_t late; // frames that took longer than the period
+    double mean;
+    double m2; // sum of squared differences from the mean (Welford)
+    double min;
+    double max;
+} Pacer;
+
+void Pacer_Init(Pacer *pacer, uint32_t fps, bool vsync);
+void Pacer_Wait(Pacer *pacer);
+double Pacer_Jitter(const Pacer *pacer);
+void Pacer_Print(const Pacer *pacer, const char *name);
+
+#endif
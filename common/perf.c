@@ -0,0 +1,173 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf.h"
+
+#define L1_READ_MISS (PERF_COUNT_HW_CACHE_L1D | \
+                      PERF_COUNT_HW_CACHE_OP_READ << 8 | \
+                      PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} events[PERF_COUNTERS] = {
+    [PERF_CYCLES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [PERF_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    [PERF_L1_MISSES] = {PERF_TYPE_HW_CACHE, L1_READ_MISS},
+    [PERF_LLC_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    [PERF_BRANCH_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+static int
+openCounter(uint32_t counter,
+            int leader)
+// Counts this thread only, in user space, on any CPU.
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[counter].type;
+    attr.config = events[counter].config;
+    attr.disabled = leader < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+static bool
+readCounters(const Perf *perf,
+             uint64_t *values)
+{
+    // nr, then one value per counter in the order they were opened
+    uint64_t group[1 + PERF_COUNTERS];
+    ssize_t size = (1 + perf->opened) * sizeof(uint64_t);
+
+    if (read(perf->leader, group, size) != size) return false;
+
+    for (uint32_t i = 0; i < PERF_COUNTERS; ++i)
+        values[i] = perf->fds[i] >= 0 ? group[1 + perf->slots[i]] : 0;
+    return true;
+}
+
+bool
+Perf_Init(Perf *perf,
+          const char *const *names,
+          uint32_t count)
+// Cycles have to open, everything else is optional.
+{
+    memset(perf, 0, sizeof(*perf));
+    perf->leader = -1;
+    for (uint32_t i = 0; i < PERF_COUNTERS; ++i) perf->fds[i] = -1;
+
+    if (count > PERF_MAX_PHASES) count = PERF_MAX_PHASES;
+    perf->phase_count = count;
+    for (uint32_t i = 0; i < count; ++i) perf->phases[i].name = names[i];
+
+    perf->leader = openCounter(PERF_CYCLES, -1);
+    if (perf->leader < 0) {
+        fprintf(stderr, "perf: counters not available (%s)%s\n",
+                strerror(errno), errno == EACCES || errno == EPERM ?
+                ", try lowering /proc/sys/kernel/perf_event_paranoid" : "");
+        return false;
+    }
+    perf->fds[PERF_CYCLES] = perf->leader;
+    perf->slots[PERF_CYCLES] = perf->opened++;
+
+    for (uint32_t i = 0; i < PERF_COUNTERS; ++i) {
+        if (i == PERF_CYCLES) continue;
+        perf->fds[i] = openCounter(i, perf->leader);
+        if (perf->fds[i] >= 0) perf->slots[i] = perf->opened++;
+    }
+
+    ioctl(perf->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perf->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    perf->enabled = true;
+    return true;
+}
+
+void
+Perf_Begin(Perf *perf)
+{
+    if (!perf->enabled) return;
+    if (!readCounters(perf, perf->start)) perf->enabled = false;
+}
+
+void
+Perf_End(Perf *perf,
+         uint32_t phase,
+         uint32_t balls)
+// Adds everything counted since Perf_Begin to phase, then starts counting
+// again so phases can follow each other without a Perf_Begin in between.
+{
+    uint64_t now[PERF_COUNTERS];
+
+    if (!perf->enabled || phase >= perf->phase_count) return;
+    if (!readCounters(perf, now)) {
+        perf->enabled = false;
+        return;
+    }
+
+    Phase *p = &perf->phases[phase];
+    p->calls++;
+    p->balls += balls;
+    for (uint32_t i = 0; i < PERF_COUNTERS; ++i) {
+        p->counts[i] += now[i] - perf->start[i];
+        perf->start[i] = now[i];
+    }
+}
+
+void
+Perf_Print(const Perf *perf,
+           FILE *out,
+           const char *name)
+{
+    static const char *counter_names[PERF_COUNTERS] = {
+        [PERF_L1_MISSES] = "L1",
+        [PERF_LLC_MISSES] = "LLC",
+        [PERF_BRANCH_MISSES] = "branch",
+    };
+
+    if (perf->opened == 0) return;
+
+    fprintf(out, "%s: %-12s %8s %12s %6s", name, "phase", "calls",
+            "cycles/call", "IPC");
+    for (uint32_t i = PERF_L1_MISSES; i < PERF_COUNTERS; ++i)
+        if (perf->fds[i] >= 0) fprintf(out, " %10s", counter_names[i]);
+    fprintf(out, "  (misses per ball)\n");
+
+    for (uint32_t i = 0; i < perf->phase_count; ++i) {
+        const Phase *p = &perf->phases[i];
+        const uint64_t *c = p->counts;
+
+        if (p->calls == 0) continue;
+
+        fprintf(out, "%s: %-12s %8lu %12.0f %6.2f", name, p->name,
+                (unsigned long)p->calls, c[PERF_CYCLES] / (double)p->calls,
+                c[PERF_CYCLES] ?
+                c[PERF_INSTRUCTIONS] / (double)c[PERF_CYCLES] : 0);
+        for (uint32_t j = PERF_L1_MISSES; j < PERF_COUNTERS; ++j)
+            if (perf->fds[j] >= 0)
+                fprintf(out, " %10.3f",
+                        p->balls ? c[j] / (double)p->balls : 0);
+        fprintf(out, "\n");
+    }
+}
+
+void
+Perf_Free(Perf *perf)
+{
+    for (uint32_t i = 0; i < PERF_COUNTERS; ++i) {
+        if (perf->fds[i] >= 0) close(perf->fds[i]);
+        perf->fds[i] = -1;
+    }
+    perf->leader = -1;
+    perf->enabled = false;
+}
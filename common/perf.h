@@ -0,0 +1,45 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+
+// Hardware counters (Linux perf_event_open) summed over named phases of a
+// frame, to see whether a loop is slow because of cache misses or branch
+// mispredicts rather than just how long it took. The counters are opened as
+// one group for this thread and read together at every phase boundary.
+//
+// If the kernel refuses (perf_event_paranoid, containers, no PMU in a VM)
+// Perf_Init says why and every other call does nothing.
+
+#define PERF_MAX_PHASES 8
+
+enum {PERF_CYCLES, PERF_INSTRUCTIONS, PERF_L1_MISSES, PERF_LLC_MISSES,
+      PERF_BRANCH_MISSES, PERF_COUNTERS};
+
+typedef struct _Phase {
+    const char *name;
+    uint64_t calls;
+    uint64_t balls; // summed over calls, for misses per ball
+    uint64_t counts[PERF_COUNTERS];
+} Phase;
+
+typedef struct _Perf {
+    bool enabled;
+    int leader; // fd of the group leader, -1 if closed
+    int fds[PERF_COUNTERS]; // -1 for counters this machine does not have
+    uint32_t slots[PERF_COUNTERS]; // where each counter is in a group read
+    uint32_t opened;
+    uint64_t start[PERF_COUNTERS];
+    Phase phases[PERF_MAX_PHASES];
+    uint32_t phase_count;
+} Perf;
+
+bool Perf_Init(Perf *perf, const char *const *names, uint32_t count);
+void Perf_Begin(Perf *perf);
+void Perf_End(Perf *perf, uint32_t phase, uint32_t balls);
+void Perf_Print(const Perf *perf, FILE *out, const char *name);
+void Perf_Free(Perf *perf);
+
+#endif
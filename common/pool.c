@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+static bool
+takeTask(Worker *worker,
+         bool steal,
+         uint32_t *task)
+// The owner takes from the front, thieves from the back.
+{
+    bool found = false;
+
+    pthread_mutex_lock(&worker->lock);
+    if (worker->front < worker->back) {
+        *task = steal ? --worker->back : worker->front++;
+        found = true;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return found;
+}
+
+static void
+work(Pool *pool,
+     Worker *worker)
+{
+    uint32_t task;
+
+    for (;;) {
+        if (takeTask(worker, false, &task)) {
+            pool->task(pool->data, task, worker->id);
+            continue;
+        }
+
+        bool stole = false;
+        for (uint32_t i = 1; i < pool->worker_count && !stole; ++i) {
+            Worker *victim =
+                &pool->workers[(worker->id + i) % pool->worker_count];
+            stole = takeTask(victim, true, &task);
+        }
+
+        if (!stole) return;
+        worker->stolen++;
+        pool->task(pool->data, task, worker->id);
+    }
+}
+
+static void *
+workerThread(void *data)
+{
+    Worker *worker = data;
+    Pool *pool = worker->pool;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == seen && !pool->quit)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->quit) break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        work(pool, worker);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) pthread_cond_signal(&pool->finish);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+bool
+Pool_Init(Pool *pool,
+          uint32_t threads)
+// threads is the total including the caller, 0 for one per CPU.
+{
+    if (threads == 0) {
+        // -1 when it cannot tell
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus < 1 ? 1 : cpus;
+    }
+
+    pool->workers = calloc(threads, sizeof(Worker));
+    if (!pool->workers) return false;
+    pool->worker_count = threads;
+    pool->generation = 0;
+    pool->busy = 0;
+    pool->quit = false;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->finish, NULL);
+
+    for (uint32_t i = 0; i < threads; ++i) {
+        Worker *worker = &pool->workers[i];
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->id = i;
+        worker->pool = pool;
+
+        if (i == 0) continue;
+        if (pthread_create(&worker->thread, NULL, workerThread, worker) != 0) {
+            // run with the threads we did get
+            pool->worker_count = i;
+            break;
+        }
+    }
+
+    return true;
+}
+
+void
+Pool_Run(Pool *pool,
+         uint32_t count,
+         Pool_task task,
+         void *data)
+// Runs task(data, i, worker) for every i below count and returns once they are
+// all done.
+{
+    uint32_t n = pool->worker_count;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->data = data;
+    for (uint32_t i = 0; i < n; ++i) {
+        Worker *worker = &pool->workers[i];
+        pthread_mutex_lock(&worker->lock);
+        worker->front = (uint64_t)count * i / n;
+        worker->back = (uint64_t)count * (i + 1) / n;
+        pthread_mutex_unlock(&worker->lock);
+    }
+    pool->busy = n - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    work(pool, &pool->workers[0]);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) pthread_cond_wait(&pool->finish, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void
+Pool_Free(Pool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (uint32_t i = 1; i < pool->worker_count; ++i)
+        pthread_join(pool->workers[i].thread, NULL);
+    for (uint32_t i = 0; i < pool->worker_count; ++i)
+        pthread_mutex_destroy(&pool->workers[i].lock);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->finish);
+    free(pool->workers);
+    pool->workers = NULL;
+    pool->worker_count = 0;
+}
@@ -0,0 +1,45 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+// A fixed set of threads for running many independent tasks. Pool_Run splits
+// the task numbers into one range per worker. A worker takes tasks from the
+// front of its own range and, once it runs dry, steals from the back of the
+// others, so a few slow tasks do not leave the rest of the threads idle. The
+// calling thread works too, as worker 0.
+
+typedef void (*Pool_task) (void *data, uint32_t task, uint32_t worker);
+
+typedef struct _Worker {
+    pthread_mutex_t lock;
+    uint32_t front; // next task to take
+    uint32_t back; // one past the last task
+    uint64_t stolen; // tasks this worker took from others, since init
+    pthread_t thread;
+    uint32_t id;
+    struct _Pool *pool;
+} Worker;
+
+typedef struct _Pool {
+    Worker *workers;
+    uint32_t worker_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t finish;
+    uint64_t generation; // bumped for every Pool_Run
+    uint32_t busy; // workers still in the current run
+    bool quit;
+
+    Pool_task task;
+    void *data;
+} Pool;
+
+bool Pool_Init(Pool *pool, uint32_t threads);
+void Pool_Run(Pool *pool, uint32_t count, Pool_task task, void *data);
+void Pool_Free(Pool *pool);
+
+#endif
@@ -0,0 +1,129 @@
+#include <string.h>
+#include <time.h>
+
+#include "telemetry.h"
+
+static void
+reportDropped(Telemetry *telemetry)
+{
+    unsigned long dropped = atomic_load_explicit(&telemetry->dropped,
+                                                 memory_order_relaxed);
+
+    if (dropped == telemetry->dropped_reported) return;
+    fprintf(telemetry->out, "telemetry: %lu records dropped\n",
+            dropped - telemetry->dropped_reported);
+    telemetry->dropped_reported = dropped;
+}
+
+static bool
+drain(Telemetry *telemetry)
+// Formats everything that is in the ring right now. Returns false if there was
+// nothing to do.
+{
+    unsigned tail = atomic_load_explicit(&telemetry->tail,
+                                         memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&telemetry->head,
+                                         memory_order_acquire);
+
+    if (tail == head) return false;
+
+    for (; tail != head; ++tail) {
+        const Record *record =
+            &telemetry->records[tail & (TELEMETRY_CAPACITY - 1)];
+
+        if (record->kind < telemetry->formatter_count)
+            telemetry->formatters[record->kind](telemetry->out, record);
+    }
+
+    atomic_store_explicit(&telemetry->tail, tail, memory_order_release);
+    reportDropped(telemetry);
+    fflush(telemetry->out);
+    return true;
+}
+
+static void *
+telemetryThread(void *data)
+{
+    Telemetry *telemetry = data;
+    const struct timespec nap = {.tv_sec = 0, .tv_nsec = 1000000};
+
+    while (atomic_load_explicit(&telemetry->running, memory_order_acquire)) {
+        if (!drain(telemetry)) nanosleep(&nap, NULL);
+    }
+
+    // the game loop has stopped pushing, write out what is left
+    drain(telemetry);
+    reportDropped(telemetry);
+    fflush(telemetry->out);
+    return NULL;
+}
+
+bool
+Telemetry_Start(Telemetry *telemetry,
+                const char *path,
+                const Telemetry_formatter *formatters,
+                uint32_t formatter_count)
+// Writes to the file at path, or to stdout when path is NULL.
+{
+    atomic_init(&telemetry->head, 0);
+    atomic_init(&telemetry->tail, 0);
+    atomic_init(&telemetry->dropped, 0);
+    atomic_init(&telemetry->running, true);
+    telemetry->dropped_reported = 0;
+    telemetry->formatters = formatters;
+    telemetry->formatter_count = formatter_count;
+    telemetry->out = stdout;
+    telemetry->close_out = false;
+
+    if (path) {
+        telemetry->out = fopen(path, "w");
+        if (!telemetry->out) return false;
+        telemetry->close_out = true;
+    }
+
+    if (pthread_create(&telemetry->thread, NULL, telemetryThread,
+                       telemetry) != 0) {
+        if (telemetry->close_out) fclose(telemetry->out);
+        return false;
+    }
+
+    return true;
+}
+
+bool
+Telemetry_Push(Telemetry *telemetry,
+               uint32_t kind,
+               uint32_t frame,
+               const float *values,
+               uint32_t count)
+// Called from the game loop. Never blocks, returns false when the record had to
+// be dropped because the thread has fallen behind.
+{
+    unsigned head = atomic_load_explicit(&telemetry->head,
+                                         memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&telemetry->tail,
+                                         memory_order_acquire);
+
+    if (head - tail >= TELEMETRY_CAPACITY) {
+        atomic_fetch_add_explicit(&telemetry->dropped, 1,
+                                  memory_order_relaxed);
+        return false;
+    }
+
+    Record *record = &telemetry->records[head & (TELEMETRY_CAPACITY - 1)];
+    record->kind = kind;
+    record->frame = frame;
+    if (count > TELEMETRY_VALUES) count = TELEMETRY_VALUES;
+    if (count > 0) memcpy(record->values, values, count * sizeof(float));
+
+    atomic_store_explicit(&telemetry->head, head + 1, memory_order_release);
+    return true;
+}
+
+void
+Telemetry_Stop(Telemetry *telemetry)
+{
+    atomic_store_explicit(&telemetry->running, false, memory_order_release);
+    pthread_join(telemetry->thread, NULL);
+    if (telemetry->close_out) fclose(telemetry->out);
+}
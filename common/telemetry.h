@@ -0,0 +1,50 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+// Printing to a terminal every frame is slow enough to drag the frame rate
+// down. Instead the game loop pushes small fixed size records into a ring and
+// a background thread turns them into text. The ring has one writer (the game
+// loop) and one reader (the thread) so it needs no locks. When the ring is
+// full the record is dropped and counted rather than making the game wait.
+
+#define TELEMETRY_CAPACITY 4096 // power of two
+#define TELEMETRY_VALUES 6
+
+typedef struct _Record {
+    uint32_t kind; // index into the formatters
+    uint32_t frame;
+    float values[TELEMETRY_VALUES];
+} Record;
+
+typedef void (*Telemetry_formatter) (FILE *out, const Record *record);
+
+typedef struct _Telemetry {
+    // head is only written by the game loop and tail by the thread, keep them
+    // on their own cache lines so they do not fight over one
+    _Alignas(64) atomic_uint head;
+    _Alignas(64) atomic_uint tail;
+    _Alignas(64) atomic_ulong dropped;
+    atomic_bool running;
+    unsigned long dropped_reported;
+    FILE *out;
+    bool close_out;
+    const Telemetry_formatter *formatters;
+    uint32_t formatter_count;
+    pthread_t thread;
+    Record records[TELEMETRY_CAPACITY];
+} Telemetry;
+
+bool Telemetry_Start(Telemetry *telemetry, const char *path,
+                     const Telemetry_formatter *formatters,
+                     uint32_t formatter_count);
+bool Telemetry_Push(Telemetry *telemetry, uint32_t kind, uint32_t frame,
+                    const float *values, uint32_t count);
+void Telemetry_Stop(Telemetry *telemetry);
+
+#endif
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
+
+static uint64_t
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t
+threadId(void)
+// gettid is a system call, only make it once per thread
+{
+    static _Thread_local uint32_t tid;
+
+    if (tid == 0) tid = syscall(SYS_gettid);
+    return tid;
+}
+
+bool
+Trace_Start(Trace *trace,
+            const char *path)
+// With no path the trace stays off.
+{
+    trace->events = NULL;
+    atomic_init(&trace->count, 0);
+    atomic_init(&trace->dropped, 0);
+    trace->path = path;
+    trace->origin = now();
+
+    if (!path) return true;
+
+    trace->events = malloc(TRACE_CAPACITY * sizeof(TraceEvent));
+    if (!trace->events) return false;
+    // touch every page now rather than in the middle of a frame
+    memset(trace->events, 0, TRACE_CAPACITY * sizeof(TraceEvent));
+    return true;
+}
+
+void
+Trace_Add(Trace *trace,
+          const char *name,
+          char phase)
+{
+    unsigned i = atomic_fetch_add_explicit(&trace->count, 1,
+                                           memory_order_relaxed);
+
+    if (i >= TRACE_CAPACITY) {
+        atomic_fetch_add_explicit(&trace->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    trace->events[i] = (TraceEvent) {
+        .name = name,
+        .ns = now() - trace->origin,
+        .tid = threadId(),
+        .phase = phase,
+    };
+}
+
+bool
+Trace_Stop(Trace *trace)
+// Writes the JSON and frees the buffer. Every thread that added events has to
+// be done with the trace by now.
+{
+    if (!trace->events) return true;
+
+    FILE *out = fopen(trace->path, "w");
+    unsigned count = atomic_load(&trace->count);
+    unsigned long dropped = atomic_load(&trace->dropped);
+
+    if (count > TRACE_CAPACITY) count = TRACE_CAPACITY;
+
+    if (out) {
+        fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+        for (unsigned i = 0; i < count; ++i) {
+            const TraceEvent *e = &trace->events[i];
+            fprintf(out, "{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, "
+                    "\"pid\": %d, \"tid\": %u}%s\n", e->name, e->phase,
+                    e->ns / 1000.0, getpid(), e->tid,
+                    i + 1 < count ? "," : "");
+        }
+        fprintf(out, "]}\n");
+        fclose(out);
+    }
+
+    if (dropped > 0)
+        fprintf(stderr, "trace: %lu events dropped, buffer full\n", dropped);
+
+    free(trace->events);
+    trace->events = NULL;
+    return out != NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Begin and end events for a timeline, written out on exit as Chrome trace
+// event JSON (load it in chrome://tracing or ui.perfetto.dev) to see where a
+// slow frame went. Events go into a buffer allocated up front, any thread can
+// add to it, and once it is full further events are counted and dropped.
+//
+// Names are not copied, they have to be string literals or live as long as
+// the trace. A trace that was never started (or started with no path) is off
+// and Trace_Begin/Trace_End only check a pointer.
+
+#define TRACE_CAPACITY (1 << 20) // events
+
+typedef struct _TraceEvent {
+    const char *name;
+    uint64_t ns; // since Trace_Start
+    uint32_t tid;
+    char phase; // B or E
+} TraceEvent;
+
+typedef struct _Trace {
+    TraceEvent *events; // NULL when off
+    atomic_uint count;
+    atomic_ulong dropped;
+    uint64_t origin;
+    const char *path;
+} Trace;
+
+bool Trace_Start(Trace *trace, const char *path);
+void Trace_Add(Trace *trace, const char *name, char phase);
+bool Trace_Stop(Trace *trace);
+
+static inline void
+Trace_Begin(Trace *trace,
+            const char *name)
+{
+    if (trace->events) Trace_Add(trace, name, 'B');
+}
+
+static inline void
+Trace_End(Trace *trace,
+          const char *name)
+{
+    if (trace->events) Trace_Add(trace, name, 'E');
+}
+
+#endif